@@ -0,0 +1,122 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <memory>
+
+#include "jbus/Common.hpp"
+#include "jbus/Endpoint.hpp"
+
+namespace jbus {
+class Listener;
+
+/** Boots up to four GBA endpoints concurrently, one per virtual SI channel.
+ *  Accepted endpoints are assigned the lowest free channel [0,3] and their
+ *  JoyBoot challenges run in parallel on their own transfer threads.
+ *  The owning application drives state changes by calling pump() once per frame. */
+class BootOrchestrator {
+public:
+  enum class EChannelState { Empty, Waiting, Booting, Done, Failed };
+
+  /** Progress snapshot of a single SI channel. */
+  struct ChannelProgress {
+    EChannelState state = EChannelState::Empty;
+    EJoyReturn status = GBA_NOT_READY;
+    u8 percent = 0;
+    u32 bytesSent = 0;
+    u64 acceptTicks = 0;
+    u64 startTicks = 0;
+    u64 endTicks = 0;
+    /** Phase timings of the JoyBoot; filled once the channel is Done or Failed. */
+    JoyBootResult joyBoot;
+  };
+
+private:
+  struct Channel {
+    std::unique_ptr<Endpoint> endpoint;
+    EChannelState state = EChannelState::Empty;
+    std::atomic<int> result{-1};
+    u8 jstat = 0;
+    u8 percent = 0;
+    u32 bytesSent = 0;
+    u64 acceptTicks = 0;
+    u64 startTicks = 0;
+    u64 endTicks = 0;
+    JoyBootResult joyBoot;
+  };
+
+  std::array<Channel, 4> m_channels;
+  const u8* m_progPtr;
+  s32 m_progLen;
+  s32 m_paletteColor;
+  s32 m_paletteSpeed;
+  u64 m_settleTicks = 0;
+  u64 m_firstStartTicks = 0;
+  u64 m_lastEndTicks = 0;
+  /** Bytes uploaded by every JoyBoot that has finished, including channels since released. */
+  u64 m_finishedBytes = 0;
+
+  void startBoot(unsigned chan);
+
+public:
+  /** @brief Create orchestrator for a JoyBoot program image.
+   *  @param programp Pointer to program ROM data. It must remain resident while booting.
+   *  @param length Length of program ROM data.
+   *  @param paletteColor Palette for displaying logo in ROM header [0,6].
+   *  @param paletteSpeed Palette interpolation speed for displaying logo in ROM header [-4,4]. */
+  BootOrchestrator(const u8* programp, s32 length, s32 paletteColor = 2, s32 paletteSpeed = 2);
+  /** @brief Stops every endpoint still assigned to a channel, completing JoyBoots in progress. */
+  ~BootOrchestrator();
+
+  BootOrchestrator(const BootOrchestrator&) = delete;
+  BootOrchestrator& operator=(const BootOrchestrator&) = delete;
+
+  /** @brief Replace the program image used by JoyBoots started from now on.
+   *  Channels already booting keep reading the previous image, which must remain resident until they finish.
+   *  @param programp Pointer to program ROM data.
+   *  @param length Length of program ROM data. */
+  void setProgram(const u8* programp, s32 length);
+
+  /** @brief Set delay between accepting an endpoint and starting its JoyBoot.
+   *  @param ticks Dolphin ticks to wait after accept. */
+  void setSettleTicks(u64 ticks) { m_settleTicks = ticks; }
+
+  /** @brief Assign the lowest free SI channel to an endpoint.
+   *  @param endpoint Endpoint to take ownership of.
+   *  @return Assigned SI channel, or -1 if all four channels are occupied. */
+  int addEndpoint(std::unique_ptr<Endpoint>&& endpoint);
+
+  /** @brief Fill free SI channels with endpoints pending on a listener.
+   *  @param listener Started listener to accept from.
+   *  @return Number of endpoints accepted. */
+  unsigned acceptFrom(Listener& listener);
+
+  /** @brief Start pending JoyBoots and collect finished ones. */
+  void pump();
+
+  /** @brief Get progress of an SI channel.
+   *  @param chan SI channel [0,3]
+   *  @return Snapshot as of the last pump() call. */
+  ChannelProgress getProgress(unsigned chan) const;
+
+  /** @brief Check if every occupied channel has finished booting.
+   *  @return true if at least one channel is occupied and none are waiting or booting. */
+  bool allDone() const;
+
+  /** @brief Get aggregate upload throughput across all channels.
+   *  @return Program bytes transferred per second from the first JoyBoot start until now,
+   *          or until the last JoyBoot finished while none are waiting or booting. */
+  double getThroughput() const;
+
+  /** @brief Access endpoint assigned to an SI channel.
+   *  @param chan SI channel [0,3]
+   *  @return Endpoint, or nullptr if channel is empty. */
+  Endpoint* getEndpoint(unsigned chan) const;
+
+  /** @brief Take ownership of the endpoint assigned to an SI channel, freeing the channel.
+   *  @param chan SI channel [0,3]
+   *  @return Endpoint, or nullptr if channel is empty or still booting. */
+  std::unique_ptr<Endpoint> releaseEndpoint(unsigned chan);
+};
+
+} // namespace jbus
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+#include "jbus/Common.hpp"
+
+namespace jbus {
+
+struct JoyBootResult;
+
+/** Builds a Chrome trace-event JSON document, viewable in chrome://tracing or Perfetto.
+ *  Timestamps are Dolphin ticks (jbus::GetGCTicks) and are converted to microseconds. */
+class ChromeTraceWriter {
+  std::string m_json = "{\"traceEvents\":[";
+  bool m_first = true;
+
+  void beginEvent(std::string_view name, std::string_view category, char phase, u64 ticks, u32 pid, u32 tid);
+
+public:
+  /** @brief Add a complete ("X") event spanning a time range.
+   *  @param name Event name.
+   *  @param category Comma-separated categories for filtering.
+   *  @param startTicks Start timestamp.
+   *  @param endTicks End timestamp; ranges ending before they start are clamped to zero duration.
+   *  @param pid Process lane.
+   *  @param tid Thread lane within the process.
+   *  @param args Optional pre-formatted JSON object body for the args field, e.g. "\"bytes\":512". */
+  void complete(std::string_view name, std::string_view category, u64 startTicks, u64 endTicks, u32 pid, u32 tid,
+                std::string_view args = {});
+
+  /** @brief Add an instant ("i") event.
+   *  @param name Event name.
+   *  @param category Comma-separated categories for filtering.
+   *  @param ticks Timestamp.
+   *  @param pid Process lane.
+   *  @param tid Thread lane within the process. */
+  void instant(std::string_view name, std::string_view category, u64 ticks, u32 pid, u32 tid);
+
+  /** @brief Name a thread lane.
+   *  @param pid Process lane.
+   *  @param tid Thread lane within the process.
+   *  @param name Display name. */
+  void threadName(u32 pid, u32 tid, std::string_view name);
+
+  /** @brief Add the phases of one JoyBoot as nested complete events.
+   *  @param result Result passed to the FGBAJoyBootCallback.
+   *  @param pid Process lane.
+   *  @param tid Thread lane; the SI channel or a per-client index works well. */
+  void joyBoot(const JoyBootResult& result, u32 pid, u32 tid);
+
+  /** @brief Take the text accumulated so far, leaving the document open for more events.
+   *  Lets long-running writers stream a trace; concatenating every drain() and the final finish() yields the document.
+   *  @return JSON text added since the previous drain(). */
+  std::string drain();
+
+  /** @brief Close the document.
+   *  @return Complete JSON text, or the remainder after drain(). No further events may be added. */
+  std::string finish();
+
+  /** @brief Close the document and write it to a file.
+   *  @param path Destination file.
+   *  @return true if written. */
+  bool write(const char* path);
+};
+
+} // namespace jbus
@@ -1,6 +1,8 @@
 #pragma once
 
+#include <array>
 #include <functional>
+#include <cstddef>
 #include <cstdint>
 #include <cstdlib>
 
@@ -147,11 +149,32 @@ enum EJoyReturn {
   GBA_JOYBOOT_ERR_INVALID = 4
 };
 
+/** Submission lane of a jbus::Endpoint operation.
+ *  Each lane holds one operation at a time, so operations of a lane complete in submission order.
+ *  Between JoyBus cycles the transfer thread serves the highest lane with work pending;
+ *  a High command therefore runs between two words of an in-flight Bulk block stream.
+ *  A JoyBoot is exclusive instead: it starts only with every lane idle, and no lane accepts
+ *  work until it completes, since any other command would corrupt the handshake or upload. */
+enum class EJoyLane : u8 {
+  High,   /**< Latency-sensitive polls, e.g. STATUS checks for input */
+  Normal, /**< Default for single commands and JoyBoot */
+  Bulk    /**< Block streams; single commands may be queued behind them here */
+};
+
+/** 4-byte data packet carried by JoyBus READ and WRITE commands. */
+using ReadWriteBuffer = std::array<u8, 4>;
+
 /** @brief Standard callback for asynchronous jbus::Endpoint APIs.
  *  @param endpoint Thread-local Endpoint interface for optionally issuing next command in sequence.
  *  @param status GBA_READY if connection is still open, GBA_NOT_READY if connection lost. */
 using FGBACallback = std::function<void(ThreadLocalEndpoint& endpoint, EJoyReturn status)>;
 
+/** @brief Completion callback for block-oriented jbus::Endpoint APIs.
+ *  @param endpoint Thread-local Endpoint interface for optionally issuing next command in sequence.
+ *  @param status GBA_READY if the whole block was transferred, GBA_NOT_READY if connection lost.
+ *  @param transferred Number of bytes moved before completion. */
+using FGBABlockCallback = std::function<void(ThreadLocalEndpoint& endpoint, EJoyReturn status, size_t transferred)>;
+
 /** @brief Get host system's timebase scaled into Dolphin ticks.
  *  @return Scaled ticks from host timebase. */
 u64 GetGCTicks();
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace jbus {
+
+/** Thread pool for running jbus::Endpoint completion callbacks off the transfer thread.
+ *  Callbacks of a single Endpoint run in submission order (one strand per Endpoint),
+ *  while idle workers steal ready strands from busy ones.
+ *  Attach to an Endpoint via jbus::Endpoint::setCompletionExecutor. */
+class CompletionExecutor {
+public:
+  /** Ordered task queue; at most one worker runs a strand at a time. */
+  class Strand {
+    friend class CompletionExecutor;
+    std::mutex m_lock;
+    std::condition_variable m_idleCv;
+    std::deque<std::function<void()>> m_tasks;
+    unsigned m_home;
+    bool m_scheduled = false;
+
+  public:
+    explicit Strand(unsigned home) : m_home(home) {}
+  };
+
+private:
+  struct Worker {
+    std::mutex lock;
+    std::deque<Strand*> ready;
+    std::thread thread;
+  };
+
+  static constexpr unsigned StrandBatch = 16;
+
+  std::vector<std::unique_ptr<Worker>> m_workers;
+  std::mutex m_sleepLock;
+  std::condition_variable m_sleepCv;
+  size_t m_readyCount = 0;
+  std::atomic<unsigned> m_nextHome{0};
+  bool m_running = true;
+
+  void enqueue(Strand& strand, unsigned worker);
+  Strand* dequeue(unsigned worker);
+  void runStrand(Strand& strand, unsigned worker);
+  void workerProc(unsigned worker);
+
+public:
+  /** @brief Start worker threads.
+   *  @param threadCount Number of workers, 0 selects one per hardware thread. */
+  explicit CompletionExecutor(unsigned threadCount = 0);
+
+  /** @brief Run remaining tasks and join all workers. */
+  ~CompletionExecutor();
+
+  CompletionExecutor(const CompletionExecutor&) = delete;
+  CompletionExecutor& operator=(const CompletionExecutor&) = delete;
+
+  /** @brief Create a strand with a round-robin home worker.
+   *  @return Strand to post ordered tasks to. */
+  std::unique_ptr<Strand> makeStrand();
+
+  /** @brief Append task to a strand, scheduling it if idle.
+   *  @param strand Strand created by this executor.
+   *  @param task Functor to run on a worker thread. */
+  void post(Strand& strand, std::function<void()>&& task);
+
+  /** @brief Block until every task posted to a strand has run.
+   *  Must not be called from a task of the same strand.
+   *  @param strand Strand created by this executor. */
+  void drain(Strand& strand);
+};
+
+} // namespace jbus
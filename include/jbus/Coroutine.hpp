@@ -0,0 +1,238 @@
+#pragma once
+
+#include <array>
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <span>
+#include <type_traits>
+#include <utility>
+
+#include "jbus/Common.hpp"
+
+namespace jbus {
+
+/** Recycling allocator for coroutine frames.
+ *  Every jbus::Endpoint owns one; jbus::Task coroutines taking an Endpoint&
+ *  parameter allocate their frame from it. Frames must be destroyed before
+ *  the owning Endpoint. */
+class FramePool {
+  struct Block {
+    Block* next;
+  };
+
+  static constexpr size_t Granularity = 64;
+  static constexpr size_t ClassCount = 16;
+
+  std::mutex m_lock;
+  std::array<Block*, ClassCount> m_free{};
+
+public:
+  FramePool() = default;
+  ~FramePool();
+
+  FramePool(const FramePool&) = delete;
+  FramePool& operator=(const FramePool&) = delete;
+
+  /** @brief Allocate a coroutine frame.
+   *  @param pool Pool to recycle from, or nullptr for the global heap.
+   *  @param size Frame size requested by the compiler.
+   *  @return Frame storage. */
+  static void* Allocate(FramePool* pool, size_t size);
+
+  /** @brief Return a coroutine frame to its pool.
+   *  @param ptr Frame storage obtained from Allocate.
+   *  @param size Frame size requested by the compiler. */
+  static void Deallocate(void* ptr, size_t size);
+};
+
+/** @brief Obtain coroutine frame pool of an Endpoint.
+ *  @param endpoint Endpoint owning the pool.
+ *  @return Frame pool. */
+FramePool& GetFramePool(Endpoint& endpoint);
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+namespace detail {
+
+template <typename... Args>
+FramePool* FindFramePool(Args&... args) {
+  FramePool* ret = nullptr;
+  auto visit = [&ret](auto& arg) {
+    if constexpr (std::is_same_v<std::remove_cv_t<std::remove_reference_t<decltype(arg)>>, Endpoint>)
+      if (!ret)
+        ret = &GetFramePool(arg);
+  };
+  (visit(args), ...);
+  return ret;
+}
+
+class PromiseBase {
+  struct FinalAwaiter {
+    bool await_ready() const noexcept { return false; }
+    template <typename Promise>
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+      PromiseBase& promise = handle.promise();
+      if (promise.m_detached) {
+        handle.destroy();
+        return std::noop_coroutine();
+      }
+      return promise.m_continuation ? promise.m_continuation : std::noop_coroutine();
+    }
+    void await_resume() const noexcept {}
+  };
+
+public:
+  std::coroutine_handle<> m_continuation;
+  bool m_detached = false;
+
+  std::suspend_always initial_suspend() const noexcept { return {}; }
+  FinalAwaiter final_suspend() const noexcept { return {}; }
+  void unhandled_exception() const noexcept { std::terminate(); }
+
+  /* The first Endpoint& parameter of the coroutine selects the frame pool */
+  template <typename... Args>
+  static void* operator new(size_t size, Args&... args) {
+    return FramePool::Allocate(FindFramePool(args...), size);
+  }
+  static void operator delete(void* ptr, size_t size) { FramePool::Deallocate(ptr, size); }
+};
+
+} // namespace detail
+#endif
+
+/** Lazily-started coroutine returning T.
+ *  Either co_await it from another coroutine or start it with detach(). */
+template <typename T = void>
+class Task {
+public:
+  struct promise_type : detail::PromiseBase {
+    T m_value{};
+    Task get_return_object() { return Task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+    void return_value(T value) { m_value = std::move(value); }
+  };
+
+private:
+  std::coroutine_handle<promise_type> m_handle;
+  explicit Task(std::coroutine_handle<promise_type> handle) : m_handle(handle) {}
+
+public:
+  Task(Task&& other) noexcept : m_handle(std::exchange(other.m_handle, {})) {}
+  Task& operator=(Task&& other) noexcept {
+    if (m_handle)
+      m_handle.destroy();
+    m_handle = std::exchange(other.m_handle, {});
+    return *this;
+  }
+  ~Task() {
+    if (m_handle)
+      m_handle.destroy();
+  }
+
+  bool await_ready() const noexcept { return false; }
+  std::coroutine_handle<> await_suspend(std::coroutine_handle<> continuation) noexcept {
+    m_handle.promise().m_continuation = continuation;
+    return m_handle;
+  }
+  T await_resume() { return std::move(m_handle.promise().m_value); }
+
+  /** @brief Start coroutine on the calling thread; its frame is freed on completion. */
+  void detach() {
+    auto handle = std::exchange(m_handle, {});
+    handle.promise().m_detached = true;
+    handle.resume();
+  }
+};
+
+template <>
+class Task<void> {
+public:
+  struct promise_type : detail::PromiseBase {
+    Task get_return_object() { return Task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+    void return_void() const noexcept {}
+  };
+
+private:
+  std::coroutine_handle<promise_type> m_handle;
+  explicit Task(std::coroutine_handle<promise_type> handle) : m_handle(handle) {}
+
+public:
+  Task(Task&& other) noexcept : m_handle(std::exchange(other.m_handle, {})) {}
+  Task& operator=(Task&& other) noexcept {
+    if (m_handle)
+      m_handle.destroy();
+    m_handle = std::exchange(other.m_handle, {});
+    return *this;
+  }
+  ~Task() {
+    if (m_handle)
+      m_handle.destroy();
+  }
+
+  bool await_ready() const noexcept { return false; }
+  std::coroutine_handle<> await_suspend(std::coroutine_handle<> continuation) noexcept {
+    m_handle.promise().m_continuation = continuation;
+    return m_handle;
+  }
+  void await_resume() const noexcept {}
+
+  /** @brief Start coroutine on the calling thread; its frame is freed on completion. */
+  void detach() {
+    auto handle = std::exchange(m_handle, {});
+    handle.promise().m_detached = true;
+    handle.resume();
+  }
+};
+
+/** Outcome of an awaited jbus::Endpoint command. */
+struct CommandResult {
+  /** GBA_READY on success, otherwise the submission or transfer error. */
+  EJoyReturn status = GBA_NOT_READY;
+  /** EJStatFlags reported by the last command issued. */
+  u8 jstat = 0;
+  /** Data word of a READ command. */
+  ReadWriteBuffer data{};
+  /** Bytes moved by a block command. */
+  size_t transferred = 0;
+};
+
+/** Awaitable returned by the coroutine interface of jbus::Endpoint.
+ *  The awaiting coroutine is resumed on the transfer thread without allocating;
+ *  commands issued from there take the lock-free jbus::ThreadLocalEndpoint path. */
+class CommandAwaiter {
+public:
+  enum class EKind : u8 { Status, Reset, Read, Write, ReadBlock, WriteBlock, JoyBoot };
+
+private:
+  Endpoint& m_ep;
+  EKind m_kind;
+  EJoyLane m_lane = EJoyLane::Normal;
+  bool m_gate = false;
+  ReadWriteBuffer m_word{};
+  std::span<const u8> m_src;
+  std::span<u8> m_dst;
+  s32 m_paletteColor = 0;
+  s32 m_paletteSpeed = 0;
+  std::coroutine_handle<> m_handle;
+  CommandResult m_result;
+
+  template <typename EP>
+  EJoyReturn submit(EP& ep);
+
+public:
+  CommandAwaiter(Endpoint& ep, EKind kind, EJoyLane lane = EJoyLane::Normal) : m_ep(ep), m_kind(kind), m_lane(lane) {}
+  CommandAwaiter(Endpoint& ep, ReadWriteBuffer word, EJoyLane lane = EJoyLane::Normal)
+  : m_ep(ep), m_kind(EKind::Write), m_lane(lane), m_word(word) {}
+  CommandAwaiter(Endpoint& ep, std::span<const u8> src, bool gate)
+  : m_ep(ep), m_kind(EKind::WriteBlock), m_gate(gate), m_src(src) {}
+  CommandAwaiter(Endpoint& ep, std::span<u8> dst, bool gate)
+  : m_ep(ep), m_kind(EKind::ReadBlock), m_gate(gate), m_dst(dst) {}
+  CommandAwaiter(Endpoint& ep, std::span<const u8> program, s32 paletteColor, s32 paletteSpeed)
+  : m_ep(ep), m_kind(EKind::JoyBoot), m_src(program), m_paletteColor(paletteColor), m_paletteSpeed(paletteSpeed) {}
+
+  bool await_ready() const noexcept { return false; }
+  bool await_suspend(std::coroutine_handle<> handle);
+  CommandResult await_resume() const noexcept { return m_result; }
+};
+
+} // namespace jbus
@@ -1,18 +1,155 @@
 #pragma once
 
+#include <algorithm>
 #include <array>
+#include <atomic>
 #include <condition_variable>
 #include <cstddef>
 #include <functional>
+#include <memory>
 #include <mutex>
+#include <optional>
+#include <span>
 #include <thread>
+#include <vector>
 
 #include "jbus/Common.hpp"
+#include "jbus/CompletionExecutor.hpp"
+#include "jbus/Coroutine.hpp"
+#include "jbus/LinkConditioner.hpp"
 #include "jbus/Socket.hpp"
+#include "jbus/Thread.hpp"
 
 namespace jbus {
 
-using ReadWriteBuffer = std::array<u8, 4>;
+/** Snapshot of the asynchronous process running on a jbus::Endpoint.
+ *  Obtained without locking via jbus::Endpoint::GBAGetProcessStatus. */
+struct ProcessStatus {
+  enum class EPhase : u8 {
+    Idle,      /**< No operation in progress */
+    Command,   /**< Single STATUS, RESET, READ or WRITE command */
+    Block,     /**< Block read or write stream */
+    Challenge, /**< JoyBoot reset, status and challenge exchange */
+    Transfer,  /**< JoyBoot program upload */
+    BootPoll   /**< JoyBoot waiting for the GBA to boot the program */
+  };
+
+  /** Current phase. */
+  EPhase phase = EPhase::Idle;
+  /** true while an operation is in progress. */
+  bool busy = false;
+  /** Bytes moved by the current JoyBoot upload or block stream. */
+  u32 bytesSent = 0;
+  /** Total bytes of the current JoyBoot upload or block stream. */
+  u32 totalBytes = 0;
+  /** EJStatFlags most recently reported by the GBA. */
+  u8 lastJStat = 0;
+  /** Upload percent of the most recent JoyBoot. */
+  u8 percent = 0;
+  /** true once a JoyBoot was started on this endpoint; percent stays 0 before that. */
+  bool joyBootStarted = false;
+};
+
+/** Outcome and phase timestamps of one JoyBoot, passed to jbus::FGBAJoyBootCallback.
+ *  Timestamps are Dolphin ticks (jbus::GetGCTicks); phases never reached stay 0. */
+struct JoyBootResult {
+  /** Final status, as passed to the plain FGBACallback. */
+  EJoyReturn status = GBA_NOT_READY;
+  /** SI channel the program was booted on. */
+  u8 chan = 0;
+  /** Program bytes uploaded, including padding and CRC. */
+  u32 bytesSent = 0;
+  /** JoyBus commands issued over the whole sequence; each is one round trip. */
+  u32 commands = 0;
+  /** Status polls issued while the GBA booted the program. */
+  u32 bootPolls = 0;
+  /** Ticks spent in the challenge solver and upload cipher rather than waiting on the GBA. */
+  u64 hostTicks = 0;
+
+  /** Sequence submitted. */
+  u64 startTicks = 0;
+  /** RESET answered. */
+  u64 resetTicks = 0;
+  /** STATUS answered with the challenge ready. */
+  u64 statusTicks = 0;
+  /** Challenge nonce read. */
+  u64 challengeTicks = 0;
+  /** Session key and initial message derived. */
+  u64 keyTicks = 0;
+  /** First program word sent. */
+  u64 transmitStartTicks = 0;
+  /** Final program word and CRC acknowledged. */
+  u64 transmitEndTicks = 0;
+  /** First boot status poll issued. */
+  u64 bootPollStartTicks = 0;
+  /** GBA reported the program booted. */
+  u64 bootPollEndTicks = 0;
+  /** Boot acknowledge exchange finished. */
+  u64 acknowledgeTicks = 0;
+  /** Sequence finished, successfully or not. */
+  u64 endTicks = 0;
+};
+
+/** @brief Completion callback for jbus::Endpoint::GBAJoyBootAsync with phase timings.
+ *  @param endpoint Thread-local Endpoint interface for optionally issuing next command in sequence.
+ *  @param result Final status and phase timestamps. */
+using FGBAJoyBootCallback = std::function<void(ThreadLocalEndpoint& endpoint, const JoyBootResult& result)>;
+
+/** Construction options for jbus::Endpoint. */
+struct EndpointOptions {
+  /** Create no transfer thread; the host drives I/O through pollFds(), process() and nextDeadline().
+   *  stop() may run on any thread and waits for a concurrent process() to return; from a callback
+   *  inside process(), use requestStop() instead. */
+  bool polled = false;
+  /** Affinity, priority, name and stack size of the transfer thread. The transfer
+   *  loop needs little stack; a few hundred KiB saves memory across many endpoints. */
+  ThreadOptions transferThread;
+  /** TCP tuning applied to both sockets before the transfer thread starts. Sockets from
+   *  jbus::Listener already carry ListenerOptions::socketOptions; set this for adopted sockets. */
+  std::optional<net::SocketOptions> socketOptions;
+  /** Inject latency, jitter, bandwidth limits and partial I/O into both sockets for testing.
+   *  The clock socket uses the next seed so the two links draw independently. */
+  std::optional<net::LinkConditionerOptions> linkConditioner;
+  /** Probe a booted link with STATUS after this many Dolphin ticks without I/O, so a dead
+   *  peer is noticed before the next real command. Unbooted links are always polled. 0 disables. */
+  u64 keepaliveTicks = 0;
+  /** Treat the link as lost when a response takes longer than this many Dolphin ticks,
+   *  rather than waiting on TCP to notice a vanished emulator. 0 waits indefinitely. */
+  u64 responseTimeoutTicks = 0;
+};
+
+/** Connection health of a jbus::Endpoint, obtained via jbus::Endpoint::getHealth.
+ *  Round trips span clock sync, command and complete response; times are Dolphin ticks. */
+struct LinkHealth {
+  /** true while the link is up. */
+  bool connected = false;
+  /** Most recent command round trip. */
+  u64 lastRttTicks = 0;
+  /** Exponentially smoothed round trip (gain 1/8, as TCP's SRTT). */
+  u64 smoothedRttTicks = 0;
+  /** Fastest round trip since construction; 0 before the first response. */
+  u64 minRttTicks = 0;
+  /** Slowest round trip since construction. */
+  u64 maxRttTicks = 0;
+  /** GetGCTicks() value of the most recent complete response. */
+  u64 lastResponseTicks = 0;
+  /** STATUS probes sent on an idle booted link. */
+  u32 keepalives = 0;
+  /** Links dropped because a response exceeded EndpointOptions::responseTimeoutTicks. */
+  u32 timeouts = 0;
+  /** Links lost for any reason other than stop(). */
+  u32 disconnects = 0;
+  /** Socket pairs installed by jbus::Endpoint::reattach. */
+  u32 reattaches = 0;
+};
+
+/** @brief Progress callback for jbus::Endpoint::setProgressCallback.
+ *  @param status Status snapshot at the time of the event. */
+using FGBAProgressCallback = std::function<void(const ProcessStatus& status)>;
+
+/** @brief Disconnect callback for jbus::Endpoint::setDisconnectCallback.
+ *  @param endpoint Endpoint whose link was lost; jbus::Endpoint::reattach may be called on it. */
+using FGBADisconnectCallback = std::function<void(Endpoint& endpoint)>;
 
 /** Main class for performing JoyBoot and subsequent JoyBus I/O operations.
  *  Instances should be obtained though the jbus::Listener::accept method. */
@@ -55,7 +192,7 @@ class Endpoint {
     const u8* x8_progPtr;
     u32 xc_progLen;
     u8* x10_statusPtr;
-    FGBACallback x14_callback;
+    FGBAJoyBootCallback x14_callback;
     ReadWriteBuffer x18_readBuf;
     ReadWriteBuffer x1c_writeBuf;
     s32 x20_byteInWindow;
@@ -70,6 +207,8 @@ class Endpoint {
     u32 x64_totalBytes;
     bool m_started = true;
     bool m_initialized = false;
+    bool m_done = false;
+    JoyBootResult m_result;
 
     void _0Reset(ThreadLocalEndpoint& endpoint, EJoyReturn status);
     void _1GetStatus(ThreadLocalEndpoint& endpoint, EJoyReturn status);
@@ -82,6 +221,7 @@ class Endpoint {
     void _6BootPoll(ThreadLocalEndpoint& endpoint, EJoyReturn status);
     void _7BootAcknowledge(ThreadLocalEndpoint& endpoint, EJoyReturn status);
     void _8BootDone(ThreadLocalEndpoint& endpoint, EJoyReturn status);
+    void _finish(ThreadLocalEndpoint& endpoint, EJoyReturn status);
 
     auto bindThis(void (KawasedoChallenge::*ptmf)(ThreadLocalEndpoint&, EJoyReturn)) {
       return std::bind(ptmf, this, std::placeholders::_1, std::placeholders::_2);
@@ -90,19 +230,29 @@ class Endpoint {
   public:
     KawasedoChallenge() = default;
     KawasedoChallenge(s32 paletteColor, s32 paletteSpeed, const u8* programp, s32 length, u8* status,
-                      FGBACallback&& callback);
-    void start(Endpoint& endpoint);
+                      FGBAJoyBootCallback&& callback);
+    void start(ThreadLocalEndpoint& endpoint);
     bool started() const { return m_started; }
     u8 percentComplete() const {
       if (!x64_totalBytes)
         return 0;
-      return x34_bytesSent * 100 / x64_totalBytes;
+      return std::min(x34_bytesSent, x64_totalBytes) * 100 / x64_totalBytes;
     }
-    bool isDone() const { return !x14_callback; }
+    u32 bytesSent() const { return std::min(x34_bytesSent, x64_totalBytes); }
+    u32 totalBytes() const { return x64_totalBytes; }
+    ProcessStatus::EPhase phase() const {
+      if (!x64_totalBytes)
+        return ProcessStatus::EPhase::Challenge;
+      if (x34_bytesSent <= x64_totalBytes)
+        return ProcessStatus::EPhase::Transfer;
+      return ProcessStatus::EPhase::BootPoll;
+    }
+    bool isDone() const { return m_done; }
     explicit operator bool() const { return m_initialized; }
   };
 
   friend class ThreadLocalEndpoint;
+  friend FramePool& GetFramePool(Endpoint& endpoint);
 
   enum EJoybusCmds { CMD_RESET = 0xff, CMD_STATUS = 0x00, CMD_READ = 0x14, CMD_WRITE = 0x15 };
 
@@ -111,90 +261,282 @@ class Endpoint {
 
   net::Socket m_dataSocket;
   net::Socket m_clockSocket;
-  std::thread m_transferThread;
-  std::mutex m_syncLock;
+  net::IPAddress m_peerAddress;
+  Thread m_transferThread;
+  mutable std::mutex m_syncLock;
   std::condition_variable m_syncCv;
   std::condition_variable m_issueCv;
+  /** State of an in-flight GBAReadBlockAsync / GBAWriteBlockAsync stream.
+   *  Words are issued back-to-back by the transfer thread; the callback fires once. */
+  struct BlockStream {
+    u8* dst = nullptr;
+    const u8* src = nullptr;
+    size_t length = 0;
+    size_t transferred = 0;
+    bool gate = false;
+    FGBABlockCallback callback;
+    /* Last JOYSTAT seen while gating, carried between polled cycles */
+    bool jstatValid = false;
+    u8 jstat = 0;
+  };
+
+  /** Operation submitted on one EJoyLane. The Bulk lane's slot also owns m_block while m_blockIssued. */
+  struct CommandSlot {
+    Buffer buffer{};
+    u8* statusPtr = nullptr;
+    u8* readDstPtr = nullptr;
+    FGBACallback callback;
+    bool issued = false;
+    /* Issued by the JoyBoot sequence itself; its continuation stays inline even with an executor set */
+    bool joyBootStep = false;
+    /* Bumped on every completion so synchronous submitters wake for their own command */
+    u32 completions = 0;
+  };
+
+  /** Command cycle awaiting its response in polled mode */
+  enum class EPollCycle : u8 { None, Command, BlockGate, BlockWord, Idle };
+
   KawasedoChallenge m_joyBoot;
-  FGBACallback m_callback;
-  Buffer m_buffer{};
-  u8* m_readDstPtr = nullptr;
-  u8* m_statusPtr = nullptr;
+  std::array<CommandSlot, 3> m_lanes;
+  BlockStream m_block;
+  CompletionExecutor* m_executor = nullptr;
+  std::unique_ptr<CompletionExecutor::Strand> m_strand;
+  FramePool m_framePool;
+
+  /** Seqlock-published copy of ProcessStatus; written under m_syncLock, read lock-free */
+  struct PublishedStatus {
+    std::atomic<u32> seq{0};
+    std::atomic<ProcessStatus::EPhase> phase{ProcessStatus::EPhase::Idle};
+    std::atomic<bool> busy{false};
+    std::atomic<bool> joyBootStarted{false};
+    std::atomic<u32> bytesSent{0};
+    std::atomic<u32> totalBytes{0};
+    std::atomic<u8> lastJStat{0};
+    std::atomic<u8> percent{0};
+  } m_published;
+  FGBAProgressCallback m_progressCallback;
+  u32 m_progressGranularity = 0;
+  u32 m_progressBytes = 0;
+  ProcessStatus::EPhase m_progressPhase = ProcessStatus::EPhase::Idle;
   u64 m_lastGCTick = 0;
   u8 m_lastCmd = 0;
-  u8 m_chan;
+  u8 m_lastJStat = 0;
+  /* Read by trace spans on the transfer thread while setChan() may run elsewhere */
+  std::atomic<u8> m_chan;
   bool m_booted = false;
-  bool m_cmdIssued = false;
-  bool m_running = true;
-
+  bool m_blockIssued = false;
+  /* Link is up; cleared on loss as well as by requestStop() */
+  std::atomic<bool> m_running = true;
+  std::atomic<bool> m_stopRequested = false;
+  bool m_polled = false;
+  /* Link lost and pending work failed; reattach() may install new sockets */
+  bool m_detached = false;
+  EPollCycle m_pollCycle = EPollCycle::None;
+  CommandSlot* m_pollSlot = nullptr;
+  Buffer m_pollBuffer{};
+  size_t m_pollReceived = 0;
+  u64 m_pollIdleTicks = 0;
+  u64 m_pollStartTicks = 0;
+
+  std::optional<net::SocketOptions> m_socketOptions;
+  std::optional<net::LinkConditionerOptions> m_conditionerOptions;
+  /* Serializes socket replacement in reattach() against requestStop() shutting them down */
+  mutable std::mutex m_socketLock;
+  u64 m_keepaliveTicks = 0;
+  u64 m_responseTimeoutTicks = 0;
+  /* Set by receive() off the lock; counted once the transfer thread relocks */
+  bool m_responseTimedOut = false;
+  u64 m_lastIoTicks = 0;
+  LinkHealth m_health;
+  FGBADisconnectCallback m_disconnectCallback;
+
+  void configureSockets();
+  void dropLink();
+  void recordResponse(u64 startTicks, u64 endTicks);
+  /** Checked by submitters under m_syncLock; a link that dropped, failed its pending work or is stopping takes no
+   *  new work, since the transfer thread would never serve it */
+  bool acceptsWork() const { return m_running && !m_detached && !m_stopRequested; }
+  /** JoyBoot owns the bus from start to completion; only its own steps are issued meanwhile */
+  bool joyBootBusy() const { return m_joyBoot && !m_joyBoot.isDone(); }
+  bool canIssue(const CommandSlot& slot, bool joyBootStep = false) const {
+    return acceptsWork() && !slot.issued && (joyBootStep || !joyBootBusy());
+  }
+  bool canStartJoyBoot() { return acceptsWork() && !joyBootBusy() && !m_blockIssued && !nextIssued(); }
+  bool keepaliveDue(u64 now) const { return m_booted && m_keepaliveTicks && now >= m_lastIoTicks + m_keepaliveTicks; }
   void clockSync();
   void send(Buffer buffer);
   size_t receive(Buffer& buffer);
   size_t runBuffer(Buffer& buffer, std::unique_lock<std::mutex>& lk);
   bool idleGetStatus(std::unique_lock<std::mutex>& lk);
+  CommandSlot& laneSlot(EJoyLane lane) { return m_lanes[size_t(lane)]; }
+  /** Highest-priority lane with an operation issued, or nullptr */
+  CommandSlot* nextIssued();
+  bool buildBlockCycle(Buffer& buffer) const;
+  bool completeBlockCycle(bool word, const Buffer& buffer);
+  bool runBlockCycle(std::unique_lock<std::mutex>& lk);
   void transferProc();
+  void finishCommand(CommandSlot& slot, EJoyReturn xferStatus);
+  void finishBlock(EJoyReturn xferStatus);
+  void failPending();
+  /** Bytes the GBA answers each command with */
+  static size_t ResponseSize(u8 cmd);
+  bool beginPolledCycle(u64 now);
+  void completePolledCycle(u64 now);
+  bool closePolled();
   void transferWakeup(ThreadLocalEndpoint& endpoint, u8 status);
+  FGBAJoyBootCallback deferJoyBootCallback(FGBAJoyBootCallback&& callback);
+  void dispatchCallback(FGBACallback&& callback, EJoyReturn status, bool joyBootStep = false);
+  void dispatchBlockCallback(FGBABlockCallback&& callback, EJoyReturn status, size_t transferred);
+  ProcessStatus currentStatus() const;
+  ProcessStatus publishStatus();
+  void publishProgress();
 
   auto bindSync() { return std::bind(&Endpoint::transferWakeup, this, std::placeholders::_1, std::placeholders::_2); }
 
+  static EJoyReturn ValidateJoyBoot(s32 paletteColor, s32 paletteSpeed, const u8* programp, s32 length);
+
 public:
   /** @brief Request stop of I/O thread and block until joined.
    *  Further use of this Endpoint will return GBA_NOT_READY.
    *  The destructor calls this implicitly. */
   void stop();
 
-  /** @brief Get status of last asynchronous operation.
+  /** @brief Request stop of I/O thread without waiting for it.
+   *  Shuts the sockets down so blocked I/O returns at once; stop() then joins promptly.
+   *  Safe to call from a completion callback. */
+  void requestStop();
+
+  /** @brief Stop many endpoints, waking all of them before joining any.
+   *  @param endpoints Endpoints to stop; null entries are skipped. */
+  static void StopAll(std::span<Endpoint* const> endpoints);
+
+  /** @brief Stop many endpoints, waking all of them before joining any.
+   *  @param endpoints Endpoints to stop; null entries are skipped. */
+  static void StopAll(std::span<const std::unique_ptr<Endpoint>> endpoints);
+
+  /** @name Host event-loop integration
+   *  Endpoints created with EndpointOptions::polled have no transfer thread.
+   *  The host watches pollFds() for readability and calls process() whenever one
+   *  is readable or nextDeadline() has passed. Callbacks run inside process(), with
+   *  the same lock-free ThreadLocalEndpoint semantics as the transfer thread.
+   *  Synchronous commands must not be issued from the thread calling process().
+   *  @{ */
+
+  /** @brief Check if this endpoint was created with EndpointOptions::polled.
+   *  @return true if the host drives it through process() */
+  bool isPolled() const { return m_polled; }
+
+  /** @brief Get native sockets the host should watch for readability.
+   *  @return Socket handles; empty once disconnected or when not polled.
+   *  Not callable from a callback run by process(). */
+  std::vector<net::Socket::SocketTp> pollFds() const;
+
+  /** @brief Advance pending I/O without blocking.
+   *  Submissions made from other threads are picked up on the next call.
+   *  @param now Current GetGCTicks() value.
+   *  @return true while connected. */
+  bool process(u64 now);
+
+  /** @brief Get time at which process() must be called even if no socket is readable.
+   *  @return Absolute GetGCTicks() value, 0 if work is pending now, or ~0 if only socket events matter. */
+  u64 nextDeadline();
+
+  /** @} */
+
+  /** @brief Get status of last asynchronous operation. This does not lock the Endpoint.
    *  @param percentOut Reference to output transfer percent of GBAJoyBootAsync.
    *  @return GBA_READY when idle, or GBA_BUSY when operation in progress. */
   EJoyReturn GBAGetProcessStatus(u8& percentOut);
 
+  /** @brief Get detailed status of last asynchronous operation. This does not lock the Endpoint.
+   *  @param statusOut Reference to output consistent status snapshot.
+   *  @return GBA_READY when idle, or GBA_BUSY when operation in progress. */
+  EJoyReturn GBAGetProcessStatus(ProcessStatus& statusOut);
+
+  /** @brief Receive progress events of JoyBoot uploads and block streams.
+   *  The callback runs on the transfer thread with the Endpoint locked, whenever the
+   *  phase changes or the byte count advances by at least the given granularity.
+   *  It must not call into the Endpoint's locking interface.
+   *  @param callback Functor to execute on progress, or empty to disable.
+   *  @param granularity Minimum number of bytes between two events of the same phase. */
+  void setProgressCallback(FGBAProgressCallback&& callback, u32 granularity = 0);
+
   /** @brief Get JOYSTAT register from GBA asynchronously.
    *  @param status Destination pointer for EJStatFlags.
    *  @param callback Functor to execute when operation completes.
-   *  @return GBA_READY if submitted, or GBA_NOT_READY if another operation in progress. */
-  EJoyReturn GBAGetStatusAsync(u8* status, FGBACallback&& callback);
+   *  @param lane Submission lane; see EJoyLane.
+   *  @return GBA_READY if submitted, or GBA_NOT_READY if another operation in progress on the lane. */
+  EJoyReturn GBAGetStatusAsync(u8* status, FGBACallback&& callback, EJoyLane lane = EJoyLane::Normal);
 
   /** @brief Get JOYSTAT register from GBA synchronously.
    *  @param status Destination pointer for EJStatFlags.
-   *  @return GBA_READY if submitted, or GBA_NOT_READY if another operation in progress. */
-  EJoyReturn GBAGetStatus(u8* status);
+   *  @param lane Submission lane; see EJoyLane.
+   *  @return GBA_READY if submitted, or GBA_NOT_READY if another operation in progress on the lane. */
+  EJoyReturn GBAGetStatus(u8* status, EJoyLane lane = EJoyLane::Normal);
 
   /** @brief Send RESET command to GBA asynchronously.
    *  @param status Destination pointer for EJStatFlags.
    *  @param callback Functor to execute when operation completes.
-   *  @return GBA_READY if submitted, or GBA_NOT_READY if another operation in progress. */
-  EJoyReturn GBAResetAsync(u8* status, FGBACallback&& callback);
+   *  @param lane Submission lane; see EJoyLane.
+   *  @return GBA_READY if submitted, or GBA_NOT_READY if another operation in progress on the lane. */
+  EJoyReturn GBAResetAsync(u8* status, FGBACallback&& callback, EJoyLane lane = EJoyLane::Normal);
 
   /** @brief Send RESET command to GBA synchronously.
    *  @param status Destination pointer for EJStatFlags.
-   *  @return GBA_READY if submitted, or GBA_NOT_READY if another operation in progress. */
-  EJoyReturn GBAReset(u8* status);
+   *  @param lane Submission lane; see EJoyLane.
+   *  @return GBA_READY if submitted, or GBA_NOT_READY if another operation in progress on the lane. */
+  EJoyReturn GBAReset(u8* status, EJoyLane lane = EJoyLane::Normal);
 
   /** @brief Send READ command to GBA asynchronously.
    *  @param dst Destination reference for 4-byte packet of data.
    *  @param status Destination pointer for EJStatFlags.
    *  @param callback Functor to execute when operation completes.
-   *  @return GBA_READY if submitted, or GBA_NOT_READY if another operation in progress. */
-  EJoyReturn GBAReadAsync(ReadWriteBuffer& dst, u8* status, FGBACallback&& callback);
+   *  @param lane Submission lane; see EJoyLane.
+   *  @return GBA_READY if submitted, or GBA_NOT_READY if another operation in progress on the lane. */
+  EJoyReturn GBAReadAsync(ReadWriteBuffer& dst, u8* status, FGBACallback&& callback, EJoyLane lane = EJoyLane::Normal);
 
   /** @brief Send READ command to GBA synchronously.
    *  @param dst Destination reference for 4-byte packet of data.
    *  @param status Destination pointer for EJStatFlags.
-   *  @return GBA_READY if submitted, or GBA_NOT_READY if another operation in progress. */
-  EJoyReturn GBARead(ReadWriteBuffer& dst, u8* status);
+   *  @param lane Submission lane; see EJoyLane.
+   *  @return GBA_READY if submitted, or GBA_NOT_READY if another operation in progress on the lane. */
+  EJoyReturn GBARead(ReadWriteBuffer& dst, u8* status, EJoyLane lane = EJoyLane::Normal);
 
   /** @brief Send WRITE command to GBA asynchronously.
    *  @param src Source pointer for 4-byte packet of data. It is not required to keep resident.
    *  @param status Destination pointer for EJStatFlags.
    *  @param callback Functor to execute when operation completes.
-   *  @return GBA_READY if submitted, or GBA_NOT_READY if another operation in progress. */
-  EJoyReturn GBAWriteAsync(ReadWriteBuffer src, u8* status, FGBACallback&& callback);
+   *  @param lane Submission lane; see EJoyLane.
+   *  @return GBA_READY if submitted, or GBA_NOT_READY if another operation in progress on the lane. */
+  EJoyReturn GBAWriteAsync(ReadWriteBuffer src, u8* status, FGBACallback&& callback, EJoyLane lane = EJoyLane::Normal);
 
   /** @brief Send WRITE command to GBA synchronously.
    *  @param src Source pointer for 4-byte packet of data. It is not required to keep resident.
    *  @param status Destination pointer for EJStatFlags.
-   *  @return GBA_READY if submitted, or GBA_NOT_READY if another operation in progress. */
-  EJoyReturn GBAWrite(ReadWriteBuffer src, u8* status);
+   *  @param lane Submission lane; see EJoyLane.
+   *  @return GBA_READY if submitted, or GBA_NOT_READY if another operation in progress on the lane. */
+  EJoyReturn GBAWrite(ReadWriteBuffer src, u8* status, EJoyLane lane = EJoyLane::Normal);
+
+  /** @brief Stream a block of data to GBA asynchronously as back-to-back WRITE commands.
+   *  The final word is zero-padded when the block length is not a multiple of 4.
+   *  The stream occupies the EJoyLane::Bulk lane; High and Normal commands run between its words.
+   *  @param src Source data. It must remain resident until the callback fires.
+   *  @param status Destination pointer for EJStatFlags of the last command issued.
+   *  @param callback Functor to execute once the whole block is transferred or the connection is lost.
+   *  @param gate When true, wait for GBA to clear GBA_JSTAT_RECV before each word.
+   *  @return GBA_READY if submitted, or GBA_NOT_READY if the EJoyLane::Bulk lane is busy. */
+  EJoyReturn GBAWriteBlockAsync(std::span<const u8> src, u8* status, FGBABlockCallback&& callback,
+                                bool gate = false);
+
+  /** @brief Stream a block of data from GBA asynchronously as back-to-back READ commands.
+   *  Excess bytes of the final word are discarded when the block length is not a multiple of 4.
+   *  The stream occupies the EJoyLane::Bulk lane; High and Normal commands run between its words.
+   *  @param dst Destination data. It must remain resident until the callback fires.
+   *  @param status Destination pointer for EJStatFlags of the last command issued.
+   *  @param callback Functor to execute once the whole block is transferred or the connection is lost.
+   *  @param gate When true, wait for GBA to set GBA_JSTAT_SEND before each word.
+   *  @return GBA_READY if submitted, or GBA_NOT_READY if the EJoyLane::Bulk lane is busy. */
+  EJoyReturn GBAReadBlockAsync(std::span<u8> dst, u8* status, FGBABlockCallback&& callback, bool gate = false);
 
   /** @brief Initiate JoyBoot sequence on this endpoint.
    *  @param paletteColor Palette for displaying logo in ROM header [0,6].
@@ -203,64 +545,213 @@ public:
    *  @param length Length of program ROM data.
    *  @param status Destination pointer for EJStatFlags.
    *  @param callback Functor to execute when operation completes.
-   *  @return GBA_READY if submitted, or GBA_NOT_READY if another operation in progress. */
+   *  @return GBA_READY if submitted, or GBA_NOT_READY if an operation is in progress on any lane. */
   EJoyReturn GBAJoyBootAsync(s32 paletteColor, s32 paletteSpeed, const u8* programp, s32 length, u8* status,
                              FGBACallback&& callback);
 
+  /** @brief Initiate JoyBoot sequence, reporting phase timestamps on completion.
+   *  @param paletteColor Palette for displaying logo in ROM header [0,6].
+   *  @param paletteSpeed Palette interpolation speed for displaying logo in ROM header [-4,4].
+   *  @param programp Pointer to program ROM data.
+   *  @param length Length of program ROM data.
+   *  @param status Destination pointer for EJStatFlags.
+   *  @param callback Functor to execute with the result when operation completes.
+   *  @return GBA_READY if submitted, or GBA_NOT_READY if an operation is in progress on any lane. */
+  EJoyReturn GBAJoyBootAsync(s32 paletteColor, s32 paletteSpeed, const u8* programp, s32 length, u8* status,
+                             FGBAJoyBootCallback&& callback);
+
+  /** @name Coroutine interface
+   *  Awaitable forms of the asynchronous commands for use inside jbus::Task coroutines.
+   *  Awaiting coroutines resume on the transfer thread with a jbus::CommandResult.
+   *  @{ */
+
+  /** @brief Await JOYSTAT register from GBA. */
+  CommandAwaiter status(EJoyLane lane = EJoyLane::Normal) { return {*this, CommandAwaiter::EKind::Status, lane}; }
+
+  /** @brief Await RESET command to GBA. */
+  CommandAwaiter reset(EJoyLane lane = EJoyLane::Normal) { return {*this, CommandAwaiter::EKind::Reset, lane}; }
+
+  /** @brief Await READ command to GBA; the word is returned in CommandResult::data. */
+  CommandAwaiter read(EJoyLane lane = EJoyLane::Normal) { return {*this, CommandAwaiter::EKind::Read, lane}; }
+
+  /** @brief Await WRITE command to GBA.
+   *  @param word 4-byte packet of data.
+   *  @param lane Submission lane; see EJoyLane. */
+  CommandAwaiter write(ReadWriteBuffer word, EJoyLane lane = EJoyLane::Normal) { return {*this, word, lane}; }
+
+  /** @brief Await block stream from GBA (see GBAReadBlockAsync).
+   *  @param dst Destination data.
+   *  @param gate When true, wait for GBA to set GBA_JSTAT_SEND before each word. */
+  CommandAwaiter readBlock(std::span<u8> dst, bool gate = false) { return {*this, dst, gate}; }
+
+  /** @brief Await block stream to GBA (see GBAWriteBlockAsync).
+   *  @param src Source data.
+   *  @param gate When true, wait for GBA to clear GBA_JSTAT_RECV before each word. */
+  CommandAwaiter writeBlock(std::span<const u8> src, bool gate = false) { return {*this, src, gate}; }
+
+  /** @brief Await JoyBoot sequence (see GBAJoyBootAsync).
+   *  @param program Program ROM data.
+   *  @param paletteColor Palette for displaying logo in ROM header [0,6].
+   *  @param paletteSpeed Palette interpolation speed for displaying logo in ROM header [-4,4]. */
+  CommandAwaiter joyBoot(std::span<const u8> program, s32 paletteColor = 2, s32 paletteSpeed = 2) {
+    return {*this, program, paletteColor, paletteSpeed};
+  }
+
+  /** @} */
+
   /** @brief Get virtual SI channel assigned to this endpoint.
    *  @return SI channel [0,3] */
-  unsigned getChan() const { return m_chan; }
+  unsigned getChan() const { return m_chan.load(std::memory_order_relaxed); }
 
   /** @brief Set virtual SI channel assigned to this endpoint.
    *  @param chan SI channel [0,3] */
   void setChan(unsigned chan) {
     if (chan > 3)
       chan = 3;
-    m_chan = chan;
+    m_chan.store(u8(chan), std::memory_order_relaxed);
   }
 
+  /** @brief Run completion callbacks on an executor rather than inline on the transfer thread.
+   *  Callbacks of this endpoint keep their submission order. Their ThreadLocalEndpoint
+   *  submits through the locking Endpoint interface, since the transfer thread is no
+   *  longer suspended during the callback. Internal JoyBoot continuations stay inline.
+   *  Must be set while no operation is in progress; the executor must outlive this Endpoint.
+   *  @param executor Executor to post callbacks to, or nullptr to run them inline. */
+  void setCompletionExecutor(CompletionExecutor* executor);
+
   /** @brief Get connection status of this endpoint
    *  @return true if connected */
   bool connected() const { return m_running; }
 
-  Endpoint(u8 chan, net::Socket&& data, net::Socket&& clock);
+  /** @brief Get round-trip statistics and link event counters.
+   *  @return Consistent snapshot, taken under the Endpoint lock. */
+  LinkHealth getHealth();
+
+  /** @brief Be notified when the link is lost other than through stop().
+   *  Pending operations have already completed with GBA_NOT_READY. The callback runs on the
+   *  transfer thread, or inside process() when polled, with the Endpoint unlocked; it may call
+   *  reattach() or requestStop(). A threaded Endpoint keeps its transfer thread parked until either.
+   *  @param callback Functor to execute on disconnect, or empty to disable. */
+  void setDisconnectCallback(FGBADisconnectCallback&& callback);
+
+  /** @brief Resume a lost link over a fresh data/clock socket pair, e.g. after an emulator restart.
+   *  Channel, executor, callbacks and options carry over; the transfer thread is reused. The GBA is
+   *  treated as unbooted again and polled until a command is issued. The old sockets are closed;
+   *  polled hosts must fetch pollFds() again.
+   *  Must not race stop() on another thread; jbus::ListenerOptions::reattachHandler is the usual caller.
+   *  @param data Connected data socket.
+   *  @param clock Connected clock socket.
+   *  @param peerAddress Address of the emulator instance, if known.
+   *  @return true if attached, false if still connected or stopped (the sockets are left untouched). */
+  bool reattach(net::Socket&& data, net::Socket&& clock, const net::IPAddress& peerAddress = {});
+
+  /** @brief Get address of the emulator instance connected to this endpoint.
+   *  @return Peer address as recorded at accept time or by the last reattach(); invalid if unknown. */
+  net::IPAddress getPeerAddress() const;
+
+  /** @brief Get TCP settings the kernel applied to the data socket.
+   *  @return Effective options, e.g. to verify buffer sizes were not clamped. */
+  net::SocketOptions querySocketOptions() const;
+
+  Endpoint(u8 chan, net::Socket&& data, net::Socket&& clock, const net::IPAddress& peerAddress = {},
+           const EndpointOptions& options = {});
+
+  /** @brief Create endpoint from already-connected native sockets, e.g. received via net::ReceiveSocketPair.
+   *  The sockets are switched to blocking I/O and owned by the endpoint.
+   *  @param chan SI channel [0,3]
+   *  @param dataSocket Native data socket handle.
+   *  @param clockSocket Native clock socket handle.
+   *  @param peerAddress Address of the emulator instance, if known.
+   *  @param options Construction options.
+   *  @return Endpoint instance, ready to issue commands. */
+  static std::unique_ptr<Endpoint> Adopt(u8 chan, net::Socket::SocketTp dataSocket, net::Socket::SocketTp clockSocket,
+                                         const net::IPAddress& peerAddress = {}, const EndpointOptions& options = {});
   ~Endpoint();
 };
 
 /** Lockless wrapper interface for jbus::Endpoint.
  *  This class is constructed internally and supplied as a callback argument.
- *  It should not be constructed directly. */
+ *  It should not be constructed directly. When the callback runs on a
+ *  jbus::CompletionExecutor, submissions fall back to the locking Endpoint interface. */
 class ThreadLocalEndpoint {
   friend class Endpoint;
+  friend class CommandAwaiter;
   Endpoint& m_ep;
-  ThreadLocalEndpoint(Endpoint& ep) : m_ep(ep) {}
+  bool m_deferred;
+  /* Handed to JoyBoot steps, whose submissions are exempt from JoyBoot exclusivity */
+  bool m_joyBootStep;
+  ThreadLocalEndpoint(Endpoint& ep, bool deferred = false, bool joyBootStep = false)
+  : m_ep(ep), m_deferred(deferred), m_joyBootStep(joyBootStep) {}
 
 public:
   /** @brief Get JOYSTAT register from GBA asynchronously.
    *  @param status Destination pointer for EJStatFlags.
    *  @param callback Functor to execute when operation completes.
-   *  @return GBA_READY if submitted, or GBA_NOT_READY if another operation in progress. */
-  EJoyReturn GBAGetStatusAsync(u8* status, FGBACallback&& callback);
+   *  @param lane Submission lane; see EJoyLane.
+   *  @return GBA_READY if submitted, or GBA_NOT_READY if another operation in progress on the lane. */
+  EJoyReturn GBAGetStatusAsync(u8* status, FGBACallback&& callback, EJoyLane lane = EJoyLane::Normal);
 
   /** @brief Send RESET command to GBA asynchronously.
    *  @param status Destination pointer for EJStatFlags.
    *  @param callback Functor to execute when operation completes.
-   *  @return GBA_READY if submitted, or GBA_NOT_READY if another operation in progress. */
-  EJoyReturn GBAResetAsync(u8* status, FGBACallback&& callback);
+   *  @param lane Submission lane; see EJoyLane.
+   *  @return GBA_READY if submitted, or GBA_NOT_READY if another operation in progress on the lane. */
+  EJoyReturn GBAResetAsync(u8* status, FGBACallback&& callback, EJoyLane lane = EJoyLane::Normal);
 
   /** @brief Send READ command to GBA asynchronously.
    *  @param dst Destination reference for 4-byte packet of data.
    *  @param status Destination pointer for EJStatFlags.
    *  @param callback Functor to execute when operation completes.
-   *  @return GBA_READY if submitted, or GBA_NOT_READY if another operation in progress. */
-  EJoyReturn GBAReadAsync(ReadWriteBuffer& dst, u8* status, FGBACallback&& callback);
+   *  @param lane Submission lane; see EJoyLane.
+   *  @return GBA_READY if submitted, or GBA_NOT_READY if another operation in progress on the lane. */
+  EJoyReturn GBAReadAsync(ReadWriteBuffer& dst, u8* status, FGBACallback&& callback, EJoyLane lane = EJoyLane::Normal);
 
   /** @brief Send WRITE command to GBA asynchronously.
    *  @param src 4-byte packet of data. It is not required to keep resident.
    *  @param status Destination pointer for EJStatFlags.
    *  @param callback Functor to execute when operation completes.
-   *  @return GBA_READY if submitted, or GBA_NOT_READY if another operation in progress. */
-  EJoyReturn GBAWriteAsync(ReadWriteBuffer src, u8* status, FGBACallback&& callback);
+   *  @param lane Submission lane; see EJoyLane.
+   *  @return GBA_READY if submitted, or GBA_NOT_READY if another operation in progress on the lane. */
+  EJoyReturn GBAWriteAsync(ReadWriteBuffer src, u8* status, FGBACallback&& callback, EJoyLane lane = EJoyLane::Normal);
+
+  /** @brief Stream a block of data to GBA asynchronously as back-to-back WRITE commands.
+   *  @param src Source data. It must remain resident until the callback fires.
+   *  @param status Destination pointer for EJStatFlags of the last command issued.
+   *  @param callback Functor to execute once the whole block is transferred or the connection is lost.
+   *  @param gate When true, wait for GBA to clear GBA_JSTAT_RECV before each word.
+   *  @return GBA_READY if submitted, or GBA_NOT_READY if the EJoyLane::Bulk lane is busy. */
+  EJoyReturn GBAWriteBlockAsync(std::span<const u8> src, u8* status, FGBABlockCallback&& callback,
+                                bool gate = false);
+
+  /** @brief Stream a block of data from GBA asynchronously as back-to-back READ commands.
+   *  @param dst Destination data. It must remain resident until the callback fires.
+   *  @param status Destination pointer for EJStatFlags of the last command issued.
+   *  @param callback Functor to execute once the whole block is transferred or the connection is lost.
+   *  @param gate When true, wait for GBA to set GBA_JSTAT_SEND before each word.
+   *  @return GBA_READY if submitted, or GBA_NOT_READY if the EJoyLane::Bulk lane is busy. */
+  EJoyReturn GBAReadBlockAsync(std::span<u8> dst, u8* status, FGBABlockCallback&& callback, bool gate = false);
+
+  /** @brief Initiate JoyBoot sequence on this endpoint.
+   *  @param paletteColor Palette for displaying logo in ROM header [0,6].
+   *  @param paletteSpeed Palette interpolation speed for displaying logo in ROM header [-4,4].
+   *  @param programp Pointer to program ROM data.
+   *  @param length Length of program ROM data.
+   *  @param status Destination pointer for EJStatFlags.
+   *  @param callback Functor to execute when operation completes.
+   *  @return GBA_READY if submitted, or GBA_NOT_READY if an operation is in progress on any lane. */
+  EJoyReturn GBAJoyBootAsync(s32 paletteColor, s32 paletteSpeed, const u8* programp, s32 length, u8* status,
+                             FGBACallback&& callback);
+
+  /** @brief Initiate JoyBoot sequence, reporting phase timestamps on completion.
+   *  @param paletteColor Palette for displaying logo in ROM header [0,6].
+   *  @param paletteSpeed Palette interpolation speed for displaying logo in ROM header [-4,4].
+   *  @param programp Pointer to program ROM data.
+   *  @param length Length of program ROM data.
+   *  @param status Destination pointer for EJStatFlags.
+   *  @param callback Functor to execute with the result when operation completes.
+   *  @return GBA_READY if submitted, or GBA_NOT_READY if an operation is in progress on any lane. */
+  EJoyReturn GBAJoyBootAsync(s32 paletteColor, s32 paletteSpeed, const u8* programp, s32 length, u8* status,
+                             FGBAJoyBootCallback&& callback);
 
   /** @brief Get virtual SI channel assigned to this endpoint.
    *  @return SI channel */
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <functional>
+#include <span>
+
+#include "jbus/Common.hpp"
+
+namespace jbus {
+
+/** Aggregate outcome of one jbus::EndpointGroup broadcast, passed to FGBAGroupCallback. */
+struct GroupResult {
+  /** Outcome on a single member endpoint. */
+  struct Member {
+    Endpoint* endpoint = nullptr;
+    /** GBA_READY on success, GBA_NOT_READY if the endpoint refused the submission or lost its connection. */
+    EJoyReturn status = GBA_NOT_READY;
+    /** false if the endpoint refused the submission, e.g. because the lane was busy. */
+    bool submitted = false;
+    /** EJStatFlags of the last command issued to this member. */
+    u8 jstat = 0;
+    /** Bytes moved by a block broadcast. */
+    size_t transferred = 0;
+  };
+
+  /** Per-member outcomes, in group order; only the first count entries are valid. */
+  std::array<Member, 4> members;
+  size_t count = 0;
+  /** GBA_READY if every member succeeded, otherwise GBA_NOT_READY. */
+  EJoyReturn status = GBA_NOT_READY;
+};
+
+/** @brief Completion callback for jbus::EndpointGroup broadcasts.
+ *  @param result Per-member statuses of the broadcast. */
+using FGBAGroupCallback = std::function<void(const GroupResult& result)>;
+
+/** Fans one command or block stream out to up to four endpoints with a single call,
+ *  e.g. the per-frame sync packet of a multiplayer session.
+ *  Members are not owned and must outlive the group. The payload is copied once and shared by
+ *  every member; polled members send it in one pass before the call returns.
+ *  A broadcast completes once, when the last member finishes. The callback runs where that
+ *  member's callbacks run (its transfer thread, process() or CompletionExecutor), or inside the
+ *  submitting call if every member finished first. Unless an executor is set, the finishing
+ *  endpoint is locked: the callback must not call into the group or the members' locking interface.
+ *  Membership changes must not race broadcasts. */
+class EndpointGroup {
+  std::array<Endpoint*, 4> m_members{};
+  size_t m_count = 0;
+
+  struct Broadcast;
+  template <typename Submit>
+  EJoyReturn broadcast(FGBAGroupCallback&& callback, std::span<const u8> payload, Submit&& submit);
+
+public:
+  EndpointGroup() = default;
+  EndpointGroup(const EndpointGroup&) = delete;
+  EndpointGroup& operator=(const EndpointGroup&) = delete;
+
+  /** @brief Add an endpoint to the group.
+   *  @param endpoint Endpoint to add; it must outlive the group.
+   *  @return false if the group is full or already contains the endpoint. */
+  bool addEndpoint(Endpoint& endpoint);
+
+  /** @brief Remove an endpoint from the group, keeping the order of the others.
+   *  @param endpoint Endpoint to remove.
+   *  @return false if the endpoint is not a member. */
+  bool removeEndpoint(Endpoint& endpoint);
+
+  /** @brief Get number of member endpoints. */
+  size_t size() const { return m_count; }
+
+  /** @brief Access a member endpoint.
+   *  @param idx Member index [0,size())
+   *  @return Endpoint, or nullptr if out of range. */
+  Endpoint* getEndpoint(size_t idx) const { return idx < m_count ? m_members[idx] : nullptr; }
+
+  /** @brief Get JOYSTAT register from every member asynchronously.
+   *  @param callback Functor to execute once every member completes.
+   *  @param lane Submission lane; see EJoyLane.
+   *  @return GBA_READY if submitted to at least one member, or GBA_NOT_READY if none accepted it. */
+  EJoyReturn GBAGetStatusAsync(FGBAGroupCallback&& callback, EJoyLane lane = EJoyLane::Normal);
+
+  /** @brief Send RESET command to every member asynchronously.
+   *  @param callback Functor to execute once every member completes.
+   *  @param lane Submission lane; see EJoyLane.
+   *  @return GBA_READY if submitted to at least one member, or GBA_NOT_READY if none accepted it. */
+  EJoyReturn GBAResetAsync(FGBAGroupCallback&& callback, EJoyLane lane = EJoyLane::Normal);
+
+  /** @brief Send WRITE command to every member asynchronously.
+   *  @param src 4-byte packet of data. It is not required to keep resident.
+   *  @param callback Functor to execute once every member completes.
+   *  @param lane Submission lane; see EJoyLane.
+   *  @return GBA_READY if submitted to at least one member, or GBA_NOT_READY if none accepted it. */
+  EJoyReturn GBAWriteAsync(ReadWriteBuffer src, FGBAGroupCallback&& callback, EJoyLane lane = EJoyLane::Normal);
+
+  /** @brief Stream a block of data to every member asynchronously as back-to-back WRITE commands.
+   *  @param src Source data. It is copied once and not required to keep resident.
+   *  @param callback Functor to execute once every member transferred the block or lost its connection.
+   *  @param gate When true, wait for each GBA to clear GBA_JSTAT_RECV before each word.
+   *  @return GBA_READY if submitted to at least one member, or GBA_NOT_READY if none accepted it. */
+  EJoyReturn GBAWriteBlockAsync(std::span<const u8> src, FGBAGroupCallback&& callback, bool gate = false);
+};
+
+} // namespace jbus
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <array>
+
+#include "jbus/Common.hpp"
+#include "jbus/Socket.hpp"
+
+namespace jbus::net {
+
+/** Impairments applied by jbus::net::LinkConditioner. Zero values disable each one. */
+struct LinkConditionerOptions {
+  /** Microseconds added to every inbound byte, i.e. the one-way delay of the link into this socket.
+   *  Condition both ends, or set this to the full round trip on one end, to emulate an RTT. */
+  u32 latencyUs = 0;
+  /** Extra delay drawn uniformly from [0, jitterUs] per inbound segment. Bytes are still delivered in order. */
+  u32 jitterUs = 0;
+  /** Inbound bandwidth cap in bytes per second; a JoyBus link runs at 14400. */
+  u32 bytesPerSec = 0;
+  /** Split each send and truncate each receive to a random 1..maxChunk bytes. */
+  u32 maxChunk = 0;
+  /** Random generator seed; equal options and seeds yield the same sequence of draws. */
+  u64 seed = 1;
+
+  /** @brief Parse a comma-separated list such as "latency=8000,jitter=2000,rate=14400,chunk=2,seed=7".
+   *  @param spec Keys latency and jitter (microseconds), rate (bytes/s), chunk (bytes) and seed; omitted keys stay zero.
+   *  @param optionsOut Receives the parsed options.
+   *  @return false if a key is unknown or a value is not a number. */
+  static bool Parse(const char* spec, LinkConditionerOptions& optionsOut);
+};
+
+/** Test-only impairment layer for jbus::net::Socket, installed with Socket::setConditioner.
+ *  Once installed, every send and receive of the socket passes through it, so Endpoint,
+ *  Listener-accepted sockets and stand-in peers are conditioned without code changes.
+ *
+ *  Delay, jitter and bandwidth act on the receive side: bytes are taken from the kernel as
+ *  soon as they arrive, stamped with a delivery time and held until then. Blocking sockets
+ *  sleep until the time passes; non-blocking sockets report Busy, and Socket::WaitReadable
+ *  and Socket::nextDelivery account for held bytes. Partial I/O applies in both directions.
+ *
+ *  Held input lives in fixed storage so conditioned sockets never allocate while sending or
+ *  receiving. Once it is full, further bytes wait in the kernel, as behind a closed TCP window. */
+class LinkConditioner {
+  struct Segment {
+    u64 dueTicks;
+    size_t size;
+  };
+
+  static constexpr size_t HeldCapacity = 4096;
+  static constexpr size_t SegmentCapacity = 128;
+
+  LinkConditionerOptions m_options;
+  u64 m_rngState;
+  u64 m_latencyTicks;
+  u64 m_jitterTicks;
+  std::array<u8, HeldCapacity> m_held;
+  size_t m_heldOffset = 0;
+  size_t m_heldEnd = 0;
+  /** Ring of held segments, oldest at m_segmentHead */
+  std::array<Segment, SegmentCapacity> m_segments;
+  size_t m_segmentHead = 0;
+  size_t m_segmentCount = 0;
+  u64 m_linkFreeTicks = 0;
+  u64 m_lastDueTicks = 0;
+
+  u64 nextRandom(u64 bound) noexcept;
+  size_t chunkSize(size_t len) noexcept;
+  bool full() const noexcept { return m_segmentCount == SegmentCapacity || m_heldEnd - m_heldOffset == HeldCapacity; }
+  Socket::EResult ingest(Socket& socket) noexcept;
+
+public:
+  explicit LinkConditioner(const LinkConditionerOptions& options);
+
+  /** @brief Send through the socket, split into random chunks if configured.
+   *  @return Result of the underlying sends; transferred counts bytes accepted by the kernel. */
+  Socket::EResult send(Socket& socket, const void* buf, size_t len, size_t& transferred) noexcept;
+
+  /** @brief Receive held bytes that are due, taking newly arrived bytes from the socket first.
+   *  @return OK with at least one byte, Busy if nothing is due on a non-blocking socket, or Error. */
+  Socket::EResult recv(Socket& socket, void* buf, size_t len, size_t& transferred) noexcept;
+
+  /** @brief Get delivery time of the oldest held bytes.
+   *  @return Absolute GetGCTicks() value, or ~0 if nothing is held. */
+  u64 nextDelivery() const { return m_segmentCount ? m_segments[m_segmentHead].dueTicks : ~u64(0); }
+
+  /** @brief Discard held bytes and link timing, e.g. when the socket closes. The generator keeps its state. */
+  void reset();
+
+  const LinkConditionerOptions& getOptions() const { return m_options; }
+};
+
+} // namespace jbus::net
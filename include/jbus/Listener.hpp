@@ -1,38 +1,191 @@
 #pragma once
 
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
 #include <memory>
 #include <mutex>
 #include <queue>
+#include <string>
 #include <thread>
+#include <unordered_map>
+#include <vector>
 
+#include "jbus/Common.hpp"
+#include "jbus/Endpoint.hpp"
+#include "jbus/MPMCQueue.hpp"
 #include "jbus/Socket.hpp"
+#include "jbus/Thread.hpp"
 
 namespace jbus {
-class Endpoint;
 
-/** Server interface for accepting incoming connections from GBA emulator instances. */
+/** Called on the resolver thread once the host name of an accepted peer is known.
+ *  Endpoints can be matched against it via jbus::Endpoint::getPeerAddress. */
+using FHostnameCallback = std::function<void(const net::IPAddress& address, const std::string& hostname)>;
+
+/** Called on the listener thread with each matched data/clock pair instead of creating an Endpoint.
+ *  Use it to hand links to other processes (see net::SendSocketPair); unclaimed sockets are closed on return. */
+using FPairHandler = std::function<void(net::Socket& data, net::Socket& clock, const net::IPAddress& address)>;
+
+/** Called on the listener thread with each matched data/clock pair before an Endpoint is created for it.
+ *  Return true after claiming the sockets, typically via jbus::Endpoint::reattach on an endpoint whose
+ *  emulator restarted; return false to let the pair through as a new connection. */
+using FReattachHandler = std::function<bool(net::Socket& data, net::Socket& clock, const net::IPAddress& address)>;
+
+/** Tunables for jbus::Listener. */
+struct ListenerOptions {
+  /** Local address to bind both server sockets to. */
+  std::string bindAddress = "127.0.0.1";
+  /** TCP port of the data server; Dolphin uses 0xd6ba. */
+  u16 dataPort = 0xd6ba;
+  /** TCP port of the clock server; Dolphin uses 0xc10c. */
+  u16 clockPort = 0xc10c;
+  /** Number of Listener shards sharing the ports via SO_REUSEPORT, each typically
+   *  drained by its own worker thread. When greater than 1, incoming connections are
+   *  steered by source address so the data and clock connections of one peer land on
+   *  the same shard. The source port cannot take part, since a peer's two connections
+   *  come from unrelated ports; all peers of one host therefore share a shard, and
+   *  sharding spreads nothing for emulators on loopback.
+   *  Every shard must live in the same process: steering relies on each shard joining the
+   *  data and clock groups at the same position, which holds only while binds are serialized in-process. */
+  u32 shardCount = 1;
+  /** Pending connection backlog of each server socket. */
+  int backlog = net::Socket::DefaultBacklog;
+  /** Dolphin ticks an accepted data or clock socket may wait for its counterpart before being closed. */
+  u64 pairTimeoutTicks = GetGCTicksPerSec() * 5;
+  /** Number of paired endpoints held for accept(); rounded up to a power of two. Fixed at construction. */
+  size_t queueCapacity = 64;
+  /** Endpoints the listener thread holds back while the accept() queue is full. Pairs
+   *  matched beyond that are closed and counted in ListenerStats::refused. */
+  size_t overflowCapacity = 64;
+  /** Reverse-resolve accepted peers on a dedicated thread and report them to this callback.
+   *  Leave empty to skip name resolution entirely. */
+  FHostnameCallback hostnameCallback;
+  /** Affinity, priority, name and stack size of the listener thread. */
+  ThreadOptions listenerThread;
+  /** TCP tuning applied to both server sockets and to every accepted socket. */
+  net::SocketOptions socketOptions;
+  /** Options for each Endpoint the listener creates, e.g. polled mode or transfer thread settings. */
+  EndpointOptions endpointOptions;
+  /** Receive matched socket pairs directly; accept() then never yields endpoints.
+   *  Leave empty to queue jbus::Endpoint instances as usual. */
+  FPairHandler pairHandler;
+  /** Offer matched pairs to existing endpoints first, so a reconnecting emulator resumes its
+   *  Endpoint instead of yielding a new one. Pairs it declines go to pairHandler or accept(). */
+  FReattachHandler reattachHandler;
+};
+
+/** Connection pairing statistics of a jbus::Listener. */
+struct ListenerStats {
+  /** Endpoints created from matched data/clock pairs. */
+  u64 paired = 0;
+  /** Matched pairs claimed by ListenerOptions::reattachHandler. */
+  u64 reattached = 0;
+  /** Matched pairs closed because the accept() queue and its overflow were both full. */
+  u64 refused = 0;
+  /** Data or clock sockets closed after pairTimeoutTicks without a counterpart. */
+  u64 orphaned = 0;
+  /** Dolphin ticks between the first and second half of the most recent pair. */
+  u64 lastLatencyTicks = 0;
+  /** Largest pairing latency observed in Dolphin ticks. */
+  u64 maxLatencyTicks = 0;
+  /** Sum of all pairing latencies in Dolphin ticks; divide by paired for the mean. */
+  u64 totalLatencyTicks = 0;
+};
+
+/** Server interface for accepting incoming connections from GBA emulator instances.
+ *  Data and clock connections are matched per peer address in arrival order,
+ *  so any number of emulator instances may connect concurrently. */
 class Listener {
+  /** Accepted socket awaiting its data/clock counterpart */
+  struct PendingSocket {
+    net::Socket socket{true};
+    net::IPAddress address;
+    u64 acceptTicks = 0;
+  };
+
+  /** Unmatched halves of connections from one peer address */
+  struct PendingPeer {
+    std::deque<PendingSocket> data;
+    std::deque<PendingSocket> clock;
+  };
+
+  ListenerOptions m_options;
   net::Socket m_dataServer{false};
   net::Socket m_clockServer{false};
-  std::thread m_listenerThread;
-  std::mutex m_queueLock;
-  std::queue<std::unique_ptr<Endpoint>> m_endpointQueue;
-  bool m_running = false;
+  Thread m_listenerThread;
+  MPMCQueue<std::unique_ptr<Endpoint>> m_endpointQueue;
+  std::deque<std::unique_ptr<Endpoint>> m_overflow;
+  /* Lets consumers wake the listener thread once they free room for the overflow */
+  std::atomic<bool> m_overflowPending = false;
+  std::mutex m_waitLock;
+  std::condition_variable m_waitCv;
+  std::atomic<unsigned> m_waiters = 0;
+  std::unordered_map<u32, PendingPeer> m_pending;
+  std::mutex m_statsLock;
+  ListenerStats m_stats;
+  std::atomic<bool> m_running = false;
+
+  net::WakeEvent m_wake;
+
+  /** Lookup queue shared with the resolver thread. A lookup cannot be interrupted,
+   *  so stop() detaches a busy resolver rather than waiting on DNS. */
+  struct Resolver {
+    std::mutex lock;
+    std::condition_variable cv;
+    std::queue<net::IPAddress> queue;
+    FHostnameCallback callback;
+    bool running = true;
+  };
+  std::shared_ptr<Resolver> m_resolver;
+  std::thread m_resolverThread;
 
   void listenerProc();
+  static void resolverProc(std::shared_ptr<Resolver> resolver);
+  void drainAccepts(net::Socket& server, bool clock);
+  void pairPending();
+  void publishEndpoint(std::unique_ptr<Endpoint>&& endpoint);
+  void flushOverflow();
+  void notifyPopped();
 
 public:
-  /** @brief Start listener thread. */
-  void start();
+  /** @brief Start listener thread.
+   *  @return true if started; false if the thread could not be created (the listener stays stopped). */
+  bool start();
 
-  /** @brief Request stop of listener thread and block until joined. */
+  /** @brief Request stop of listener thread and block until joined.
+   *  Returns promptly; no further hostname callbacks start afterwards. */
   void stop();
 
-  /** @brief Pop jbus::Endpoint off Listener's queue.
-   *  @return Endpoint instance, ready to issue commands. */
+  /** @brief Request stop of listener thread without waiting for it.
+   *  Pending acceptWait() calls return immediately. */
+  void requestStop();
+
+  /** @brief Pop jbus::Endpoint off Listener's queue. Lock-free; safe to call from several threads.
+   *  @return Endpoint instance, ready to issue commands, or nullptr if none are pending. */
   std::unique_ptr<Endpoint> accept();
 
+  /** @brief Pop jbus::Endpoint off Listener's queue, blocking until one is available.
+   *  @param deadlineTicks Absolute GetGCTicks() value to give up at.
+   *  @return Endpoint instance, or nullptr on deadline or when the listener is stopped. */
+  std::unique_ptr<Endpoint> acceptWait(u64 deadlineTicks);
+
+  /** @brief Pop every pending jbus::Endpoint off Listener's queue.
+   *  @param out Vector to append endpoints to.
+   *  @return Number of endpoints appended. */
+  size_t acceptAll(std::vector<std::unique_ptr<Endpoint>>& out);
+
+  /** @brief Get connection pairing statistics.
+   *  @return Snapshot of counters accumulated since construction. */
+  ListenerStats getStats();
+
+  /** @brief Replace listener options. Must not be called while started; takes effect on the next start().
+   *  @param options New options. */
+  void setOptions(const ListenerOptions& options) { m_options = options; }
+
   Listener();
+  explicit Listener(const ListenerOptions& options);
   ~Listener();
 };
 
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+namespace jbus {
+
+/** Bounded lock-free multi-producer multi-consumer queue (Vyukov).
+ *  Each cell carries a sequence number that tells producers and consumers
+ *  whether it is free for the current lap, so neither side ever takes a lock.
+ *  T must be default constructible and move assignable. */
+template <typename T>
+class MPMCQueue {
+  static constexpr size_t CacheLine = 64;
+
+  struct alignas(CacheLine) Cell {
+    std::atomic<size_t> sequence;
+    T data;
+  };
+
+  std::unique_ptr<Cell[]> m_cells;
+  size_t m_mask;
+  alignas(CacheLine) std::atomic<size_t> m_enqueuePos{0};
+  alignas(CacheLine) std::atomic<size_t> m_dequeuePos{0};
+
+public:
+  /** @brief Allocate queue storage.
+   *  @param capacity Minimum number of elements; rounded up to a power of two. */
+  explicit MPMCQueue(size_t capacity) {
+    size_t size = 2;
+    while (size < capacity)
+      size <<= 1;
+    m_cells.reset(new Cell[size]);
+    m_mask = size - 1;
+    for (size_t i = 0; i < size; ++i)
+      m_cells[i].sequence.store(i, std::memory_order_relaxed);
+  }
+
+  MPMCQueue(const MPMCQueue&) = delete;
+  MPMCQueue& operator=(const MPMCQueue&) = delete;
+
+  /** @brief Append an element if there is room.
+   *  @param value Element to move in; left untouched on failure.
+   *  @return false if the queue is full. */
+  bool tryPush(T&& value) {
+    Cell* cell;
+    size_t pos = m_enqueuePos.load(std::memory_order_relaxed);
+    while (true) {
+      cell = &m_cells[pos & m_mask];
+      size_t seq = cell->sequence.load(std::memory_order_acquire);
+      intptr_t diff = intptr_t(seq) - intptr_t(pos);
+      if (diff == 0) {
+        if (m_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+          break;
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = m_enqueuePos.load(std::memory_order_relaxed);
+      }
+    }
+    cell->data = std::move(value);
+    cell->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  /** @brief Remove the oldest element if any.
+   *  @param value Receives the element on success.
+   *  @return false if the queue is empty. */
+  bool tryPop(T& value) {
+    Cell* cell;
+    size_t pos = m_dequeuePos.load(std::memory_order_relaxed);
+    while (true) {
+      cell = &m_cells[pos & m_mask];
+      size_t seq = cell->sequence.load(std::memory_order_acquire);
+      intptr_t diff = intptr_t(seq) - intptr_t(pos + 1);
+      if (diff == 0) {
+        if (m_dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+          break;
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = m_dequeuePos.load(std::memory_order_relaxed);
+      }
+    }
+    value = std::move(cell->data);
+    cell->data = T();
+    cell->sequence.store(pos + m_mask + 1, std::memory_order_release);
+    return true;
+  }
+
+  /** @brief Get number of elements the queue can hold. */
+  size_t capacity() const { return m_mask + 1; }
+};
+
+} // namespace jbus
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <vector>
+
+#include "jbus/Common.hpp"
+
+namespace jbus {
+
+/** Polls JOYSTAT of many endpoints at once, like select() for GBA state.
+ *  Each round submits one STATUS (or RESET) to every member without waiting in between, so a
+ *  round costs about one round trip however many consoles are attached. Results are kept as
+ *  dense arrays indexed like the members: the JOYSTAT bytes, the bits that changed since the
+ *  previous round, and each member's status.
+ *  Members are not owned and must outlive the group. Polled members (EndpointOptions::polled)
+ *  are driven with process() from the thread waiting in poll() or waitAny(). */
+class PollGroup {
+public:
+  enum class ECommand : u8 { Status, Reset };
+
+private:
+  struct Round;
+
+  std::vector<Endpoint*> m_members;
+  std::vector<u8> m_jstat;
+  std::vector<u8> m_changes;
+  std::vector<EJoyReturn> m_status;
+  std::shared_ptr<Round> m_round;
+  bool m_roundIssued = false;
+  EJoyLane m_lane;
+  ECommand m_command = ECommand::Status;
+
+  bool waitRound(u64 deadline);
+
+public:
+  /** @brief Create an empty group.
+   *  @param lane Submission lane of the polls; High lets them cut into block streams. */
+  explicit PollGroup(EJoyLane lane = EJoyLane::High);
+  ~PollGroup();
+
+  PollGroup(const PollGroup&) = delete;
+  PollGroup& operator=(const PollGroup&) = delete;
+
+  /** @brief Add an endpoint to the group. Its JOYSTAT reads 0 until the next round.
+   *  @param endpoint Endpoint to add; it must outlive the group.
+   *  @return false if already a member or a round is in progress. */
+  bool addEndpoint(Endpoint& endpoint);
+
+  /** @brief Remove an endpoint from the group, keeping the order of the others.
+   *  @param endpoint Endpoint to remove.
+   *  @return false if not a member or a round is in progress. */
+  bool removeEndpoint(Endpoint& endpoint);
+
+  /** @brief Get number of member endpoints. */
+  size_t size() const { return m_members.size(); }
+
+  /** @brief Access a member endpoint.
+   *  @param idx Member index [0,size())
+   *  @return Endpoint, or nullptr if out of range. */
+  Endpoint* getEndpoint(size_t idx) const { return idx < m_members.size() ? m_members[idx] : nullptr; }
+
+  /** @brief Select the command each round issues; both answer with JOYSTAT. Defaults to STATUS. */
+  void setCommand(ECommand command) { m_command = command; }
+
+  /** @brief Start a round without waiting for it.
+   *  @return GBA_READY if started, GBA_BUSY if the previous round is still in progress,
+   *  or GBA_NOT_READY if the group is empty. */
+  EJoyReturn pollAsync();
+
+  /** @brief Publish the results of a finished round without blocking.
+   *  @return true if a round finished since the last call. */
+  bool collect();
+
+  /** @brief Run one round and wait for every member to answer.
+   *  Starts a round unless one is already in progress.
+   *  @param timeoutTicks Dolphin ticks to wait for the answers.
+   *  @return GBA_READY with results published, GBA_BUSY if the round is still running at the
+   *  timeout (a later collect() or poll() picks it up), or GBA_NOT_READY if the group is empty. */
+  EJoyReturn poll(u64 timeoutTicks = GetGCTicksPerSec());
+
+  /** @brief Poll rounds until any member's JOYSTAT matches.
+   *  @param mask EJStatFlags to compare.
+   *  @param match Required value of the masked flags.
+   *  @param timeoutTicks Dolphin ticks to keep polling.
+   *  @param intervalTicks Delay between rounds.
+   *  @return Index of the first matching member of the last round, or -1 on timeout or empty group. */
+  int waitAny(u8 mask, u8 match, u64 timeoutTicks, u64 intervalTicks = GetGCTicksPerSec() / 60);
+
+  /** @brief JOYSTAT of every member as of the last published round. */
+  std::span<const u8> jstat() const { return m_jstat; }
+
+  /** @brief JOYSTAT bits that changed in the last published round, i.e. previous XOR current.
+   *  The first round reports every set bit as changed. */
+  std::span<const u8> changes() const { return m_changes; }
+
+  /** @brief Outcome per member of the last published round.
+   *  GBA_NOT_READY members were busy on the lane or disconnected; their JOYSTAT kept its previous value. */
+  std::span<const EJoyReturn> status() const { return m_status; }
+};
+
+} // namespace jbus
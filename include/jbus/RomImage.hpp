@@ -0,0 +1,98 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "jbus/Common.hpp"
+
+namespace jbus {
+
+/** Read-only JoyBoot program image, validated and ready to pass to GBAJoyBootAsync.
+ *  The file is memory-mapped privately; only the page holding the patched header
+ *  complement byte is copied, so large images are neither read up front nor duplicated.
+ *  Update images by renaming a new file over the old one; truncating a mapped file in place
+ *  faults any boot still reading it. */
+class RomImage {
+public:
+  enum class EResult { OK, OpenFailed, TooSmall, TooLarge, BadHeader };
+
+  /** Smallest image the GBA BIOS accepts (header plus padding). */
+  static constexpr size_t MinSize = 512;
+  /** Largest image that fits GBA work RAM. */
+  static constexpr size_t MaxSize = 0x40000;
+
+private:
+  std::string m_path;
+  const u8* m_data = nullptr;
+  size_t m_size = 0;
+  s64 m_mtime = 0;
+  std::unique_ptr<u8[]> m_heap;
+#ifdef _WIN32
+  void* m_mapping = nullptr;
+#endif
+
+  RomImage() = default;
+
+public:
+  ~RomImage();
+
+  RomImage(const RomImage&) = delete;
+  RomImage& operator=(const RomImage&) = delete;
+
+  /** @brief Map, validate and prepare a program image.
+   *  @param path File to load.
+   *  @param resultOut Optionally receives the reason for failure.
+   *  @return Prepared image, or nullptr on failure. */
+  static std::shared_ptr<const RomImage> Open(const std::string& path, EResult* resultOut = nullptr);
+
+  /** @brief Get a human-readable description of a load result. */
+  static const char* ResultString(EResult result);
+
+  /** @brief Get program data with the header complement fixed up. */
+  const u8* data() const { return m_data; }
+
+  /** @brief Get program length in bytes. */
+  s32 size() const { return s32(m_size); }
+
+  /** @brief Get path the image was loaded from. */
+  const std::string& path() const { return m_path; }
+
+  /** @brief Get file modification time at load, in nanoseconds since the epoch. */
+  s64 mtime() const { return m_mtime; }
+};
+
+/** Prepared jbus::RomImage instances keyed by path.
+ *  An entry is reloaded when the file's modification time or size changes;
+ *  images still referenced by in-flight boots stay alive until released. */
+class RomImageCache {
+  struct Entry {
+    std::shared_ptr<const RomImage> image;
+    s64 mtime = 0;
+    size_t size = 0;
+  };
+
+  std::mutex m_lock;
+  std::unordered_map<std::string, Entry> m_entries;
+  u64 m_hits = 0;
+  u64 m_loads = 0;
+
+public:
+  /** @brief Get a prepared image, loading it if absent or stale.
+   *  @param path File to load.
+   *  @param resultOut Optionally receives the reason for failure.
+   *  @return Prepared image, or nullptr on failure. */
+  std::shared_ptr<const RomImage> get(const std::string& path, RomImage::EResult* resultOut = nullptr);
+
+  /** @brief Drop all cached images. */
+  void clear();
+
+  /** @brief Get number of requests served without touching the file contents. */
+  u64 getHits();
+
+  /** @brief Get number of requests that (re)loaded an image. */
+  u64 getLoads();
+};
+
+} // namespace jbus
@@ -2,6 +2,7 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <memory>
 #include <string>
 
 #ifdef _WIN32
@@ -13,6 +14,9 @@ struct sockaddr_in;
 
 namespace jbus::net {
 
+class LinkConditioner;
+struct LinkConditionerOptions;
+
 /** IP address class derived from SFML */
 class IPAddress {
   uint32_t m_address = 0;
@@ -21,53 +25,203 @@ class IPAddress {
   void resolve(const std::string& address) noexcept;
 
 public:
+  IPAddress() noexcept = default;
   explicit IPAddress(const std::string& address) noexcept { resolve(address); }
 
+  /** @brief Construct from an address in host byte order. */
+  static IPAddress FromInteger(uint32_t address) noexcept;
+
   uint32_t toInteger() const noexcept;
+
+  /** @brief Format as dotted-quad string without any name lookup. */
+  std::string toString() const;
+
+  /** @brief Reverse-resolve host name. This may block on DNS; avoid calling it on latency-critical threads.
+   *  @return Host name, or the dotted-quad form if no name is found. */
+  std::string resolveHostname() const;
+
+  bool operator==(const IPAddress& other) const noexcept {
+    return m_valid == other.m_valid && m_address == other.m_address;
+  }
+  bool operator!=(const IPAddress& other) const noexcept { return !(*this == other); }
   explicit operator bool() const noexcept { return m_valid; }
 };
 
+/** Per-socket TCP tuning for jbus::net::Socket::applyOptions.
+ *  Zero values leave the kernel default in place. */
+struct SocketOptions {
+  /** Disable Nagle's algorithm so each command goes out immediately. */
+  bool noDelay = true;
+  /** SO_SNDBUF in bytes. Linux reports back double the requested value. */
+  int sendBuffer = 0;
+  /** SO_RCVBUF in bytes. Linux reports back double the requested value. */
+  int recvBuffer = 0;
+  /** Acknowledge immediately instead of delaying ACKs (Linux). Re-armed after every receive. */
+  bool quickAck = false;
+  /** SO_BUSY_POLL microseconds to spin on the device queue in blocking receives (Linux). */
+  int busyPollUs = 0;
+  /** Enable TCP keepalive probes for dead-peer detection. */
+  bool keepAlive = false;
+  /** Idle seconds before the first keepalive probe. */
+  int keepAliveIdleSec = 0;
+  /** Seconds between keepalive probes. */
+  int keepAliveIntervalSec = 0;
+  /** Unanswered probes before the connection is dropped. */
+  int keepAliveCount = 0;
+  /** TCP_USER_TIMEOUT: milliseconds sent data may remain unacknowledged before the connection is dropped (Linux). */
+  unsigned userTimeoutMs = 0;
+};
+
+/** Cross-thread wakeup for Socket::WaitReadable (eventfd on Linux, self-pipe on other POSIX systems).
+ *  On Windows, waits fall back to their timeout. */
+class WakeEvent {
+  int m_readHandle = -1;
+  int m_writeHandle = -1;
+
+public:
+  WakeEvent() noexcept;
+  ~WakeEvent() noexcept;
+
+  WakeEvent(const WakeEvent&) = delete;
+  WakeEvent& operator=(const WakeEvent&) = delete;
+
+  /** @brief Wake any current or future wait on this event until reset. Async-signal-safe. */
+  void signal() noexcept;
+
+  /** @brief Consume pending signals. */
+  void reset() noexcept;
+
+  /** @brief Get native handle to poll for readability; -1 if unsupported. */
+  int getHandle() const noexcept { return m_readHandle; }
+};
+
 /** Server-oriented TCP socket class derived from SFML */
 class Socket {
+public:
 #ifndef _WIN32
   using SocketTp = int;
 #else
   using SocketTp = SOCKET;
 #endif
+
+private:
   SocketTp m_socket = -1;
   bool m_isBlocking;
+  bool m_quickAck = false;
+  struct ConditionerDeleter {
+    void operator()(LinkConditioner* conditioner) const noexcept;
+  };
+  std::unique_ptr<LinkConditioner, ConditionerDeleter> m_conditioner;
 
   bool openSocket() noexcept;
-  void setRemoteSocket(int remSocket) noexcept;
+  void setRemoteSocket(SocketTp remSocket) noexcept;
 
 public:
   enum class EResult { OK, Error, Busy };
 
+private:
+  friend class LinkConditioner;
+  EResult rawSend(const void* buf, size_t len, size_t& transferred) noexcept;
+  EResult rawRecv(void* buf, size_t len, size_t& transferred) noexcept;
+  bool rawReadable() const noexcept;
+
+public:
 #ifdef _WIN32
   static EResult LastWSAError() noexcept;
 #endif
 
   explicit Socket(bool blocking) noexcept : m_isBlocking(blocking) {}
+
+  /** @brief Take ownership of an already-connected native socket, e.g. one received from another process.
+   *  @param socket Native socket handle; closed when the returned Socket is destroyed.
+   *  @param blocking Blocking mode to apply.
+   *  @return Socket owning the handle. */
+  static Socket Adopt(SocketTp socket, bool blocking) noexcept {
+    Socket ret(blocking);
+    ret.setRemoteSocket(socket);
+    return ret;
+  }
+
+  /** @brief Give up ownership of the native socket without closing it.
+   *  @return Native socket handle, or -1 if not open. */
+  SocketTp release() noexcept {
+    SocketTp ret = m_socket;
+    m_socket = -1;
+    return ret;
+  }
   ~Socket() noexcept { close(); }
 
   Socket(const Socket& other) = delete;
   Socket& operator=(const Socket& other) = delete;
-  Socket(Socket&& other) noexcept : m_socket(other.m_socket), m_isBlocking(other.m_isBlocking) { other.m_socket = -1; }
+  Socket(Socket&& other) noexcept
+  : m_socket(other.m_socket)
+  , m_isBlocking(other.m_isBlocking)
+  , m_quickAck(other.m_quickAck)
+  , m_conditioner(std::move(other.m_conditioner)) {
+    other.m_socket = -1;
+  }
   Socket& operator=(Socket&& other) noexcept {
     close();
     m_socket = other.m_socket;
     other.m_socket = -1;
     m_isBlocking = other.m_isBlocking;
+    m_quickAck = other.m_quickAck;
+    m_conditioner = std::move(other.m_conditioner);
     return *this;
   }
 
   void setBlocking(bool blocking) noexcept;
+  bool isBlocking() const noexcept { return m_isBlocking; }
+
+  /** @brief Pass all further sends and receives through a jbus::net::LinkConditioner, replacing any previous one.
+   *  For testing at emulator-over-network latencies; bytes it holds are lost on replacement.
+   *  @param options Impairments to inject. */
+  void setConditioner(const LinkConditionerOptions& options);
+
+  /** @brief Remove the conditioner; bytes it still holds are discarded. */
+  void clearConditioner() noexcept;
+
+  /** @brief Get installed conditioner, or nullptr. */
+  const LinkConditioner* getConditioner() const noexcept { return m_conditioner.get(); }
+
+  /** @brief Get time at which a conditioner releases held input.
+   *  Polling hosts must wake by then even if the socket is not readable.
+   *  @return Absolute GetGCTicks() value, or ~0 if no input is held. */
+  uint64_t nextDelivery() const noexcept;
+
+  /** @brief Apply TCP tuning. Options unsupported on this platform are skipped.
+   *  Buffer sizes set on a listening socket are inherited by accepted sockets.
+   *  @param options Settings to apply.
+   *  @return true if every supported setting was accepted by the kernel. */
+  bool applyOptions(const SocketOptions& options) noexcept;
+
+  /** @brief Read back the settings the kernel actually applied.
+   *  @return Effective options; fields unsupported on this platform are zero. */
+  SocketOptions queryOptions() const noexcept;
   bool isOpen() const noexcept { return m_socket != -1; }
-  bool openAndListen(const IPAddress& address, uint32_t port) noexcept;
+  static constexpr int DefaultBacklog = 128;
+  bool openAndListen(const IPAddress& address, uint32_t port, int backlog = DefaultBacklog,
+                     bool reusePort = false) noexcept;
+  /** @brief Steer connections of a SO_REUSEPORT group to member (source address % shardCount).
+   *  Only effective on Linux; elsewhere the kernel's own hash is used. Connections from one host
+   *  always reach the same member, so loopback clients are not spread. Member indices follow bind
+   *  order, which the caller must keep consistent across the groups it pairs.
+   *  @param shardCount Number of sockets in the group.
+   *  @return true if the steering program was attached. */
+  bool attachReusePortSteering(uint32_t shardCount) noexcept;
+  /** @brief Open and connect to a server, e.g. a jbus::Listener when standing in for a GBA.
+   *  Connects in blocking mode, then applies the socket's blocking mode.
+   *  @return true if connected. */
+  bool openAndConnect(const IPAddress& address, uint32_t port) noexcept;
   EResult accept(Socket& remoteSocketOut, sockaddr_in& fromAddress) noexcept;
   EResult accept(Socket& remoteSocketOut) noexcept;
+  /** @brief Accept connection, recording the raw peer address without any name lookup. */
+  EResult accept(Socket& remoteSocketOut, IPAddress& fromAddress, uint16_t& fromPort) noexcept;
+  /** @brief Accept connection and reverse-resolve the peer. This blocks on DNS; prefer the IPAddress overload. */
   EResult accept(Socket& remoteSocketOut, std::string& fromHostname);
   void close() noexcept;
+  /** @brief Shut down both directions without closing, waking any thread blocked in send or recv. */
+  void shutdown() noexcept;
   EResult send(const void* buf, size_t len, size_t& transferred) noexcept;
   EResult send(const void* buf, size_t len) noexcept;
   EResult recv(void* buf, size_t len, size_t& transferred) noexcept;
@@ -75,6 +229,16 @@ public:
 
   explicit operator bool() const noexcept { return isOpen(); }
 
+  /** @brief Block until any of the sockets has pending input (or a pending connection, for servers).
+   *  Input held by a LinkConditioner counts once it is due.
+   *  @param sockets Sockets to wait on; closed sockets are ignored.
+   *  @param count Number of sockets, at most 8.
+   *  @param timeoutMs Maximum time to wait in milliseconds.
+   *  @param wake Optional event that ends the wait early when signalled.
+   *  @return true if at least one socket is readable or the event was signalled. */
+  static bool WaitReadable(const Socket* const* sockets, size_t count, uint32_t timeoutMs,
+                           const WakeEvent* wake = nullptr) noexcept;
+
   SocketTp GetInternalSocket() const noexcept { return m_socket; }
 };
 
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "jbus/Socket.hpp"
+
+namespace jbus::net {
+
+/** @brief Pass a connected data/clock socket pair to another process over a Unix domain socket (SCM_RIGHTS).
+ *  Lets a front-door process own the jbus::Listener and distribute links to worker processes.
+ *  Both sockets are closed locally once the receiver holds its own copies. Not available on Windows.
+ *  @param channel Connected AF_UNIX socket (SOCK_SEQPACKET recommended).
+ *  @param data Data socket to pass.
+ *  @param clock Clock socket to pass.
+ *  @param peerAddress Peer address to forward alongside the sockets.
+ *  @return true if sent; on failure both sockets are left open. */
+bool SendSocketPair(int channel, Socket& data, Socket& clock, const IPAddress& peerAddress) noexcept;
+
+/** @brief Receive a data/clock socket pair sent with SendSocketPair, blocking until one arrives.
+ *  Received sockets use blocking I/O, ready for jbus::Endpoint::Adopt.
+ *  @param channel Connected AF_UNIX socket.
+ *  @param dataOut Receives the data socket.
+ *  @param clockOut Receives the clock socket.
+ *  @param peerAddressOut Receives the forwarded peer address.
+ *  @return true if a complete pair was received; false on error or when the sender hung up. */
+bool ReceiveSocketPair(int channel, Socket& dataOut, Socket& clockOut, IPAddress& peerAddressOut) noexcept;
+
+} // namespace jbus::net
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <pthread.h>
+#else
+#include <thread>
+#endif
+
+namespace jbus {
+
+/** Scheduling and resource settings for threads started by jbus. */
+struct ThreadOptions {
+  /** Thread name shown by debuggers and ps; truncated to 15 characters on Linux. Empty keeps the default. */
+  std::string name;
+  /** CPUs the thread may run on. Empty allows any CPU. Not supported on macOS. */
+  std::vector<unsigned> cpus;
+  /** Run under SCHED_FIFO (time-critical priority on Windows). Usually requires elevated privileges. */
+  bool realtime = false;
+  /** SCHED_FIFO priority used when realtime is set. */
+  int realtimePriority = 1;
+  /** Nice value applied when realtime is not set (Linux only). 0 keeps the default. */
+  int nice = 0;
+  /** Stack size in bytes; 0 keeps the platform default (commonly 8 MiB). Ignored on Windows. */
+  size_t stackSize = 0;
+};
+
+/** Joinable thread created with jbus::ThreadOptions.
+ *  Settings that cannot be applied (e.g. realtime without privileges) are skipped and
+ *  the thread runs with defaults instead; check optionsApplied() to find out. */
+class Thread {
+#ifndef _WIN32
+  pthread_t m_thread{};
+  bool m_joinable = false;
+#else
+  std::thread m_thread;
+#endif
+  std::atomic<bool> m_optionsApplied = false;
+
+public:
+  Thread() = default;
+  ~Thread() { join(); }
+
+  Thread(const Thread&) = delete;
+  Thread& operator=(const Thread&) = delete;
+
+  /** @brief Start thread.
+   *  @param options Scheduling and resource settings.
+   *  @param func Function run on the new thread.
+   *  @return true if the thread was started. */
+  bool start(const ThreadOptions& options, std::function<void()>&& func);
+
+  /** @brief Check if the thread was started and not yet joined. */
+  bool joinable() const;
+
+  /** @brief Block until the thread exits; no-op if not joinable. */
+  void join();
+
+  /** @brief Check if the caller is running on this thread. */
+  bool isCurrent() const;
+
+  /** @brief Check if the running thread applied every requested setting.
+   *  @return false until the thread has started, or if any setting was refused. */
+  bool optionsApplied() const { return m_optionsApplied; }
+};
+
+} // namespace jbus
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <atomic>
+
+#include "jbus/Common.hpp"
+
+namespace jbus {
+
+/** Settings for jbus::Tracer::Start. */
+struct TracerOptions {
+  /** Events each thread can hold between flushes; rounded up to a power of two.
+   *  Events recorded while a thread's buffer is full are dropped and counted. */
+  size_t eventsPerThread = 16384;
+  /** Milliseconds between background flushes to the trace file. */
+  unsigned flushIntervalMs = 100;
+};
+
+/** Opt-in process-wide recorder of jbus::Endpoint activity in Chrome trace-event format.
+ *  While started, each transfer cycle records spans for lock wait, clock sync, send,
+ *  receive and callbacks. Spans go to a lock-free buffer owned by the recording thread;
+ *  a background thread drains every buffer into the file, so recording makes no
+ *  syscalls and takes no locks. Open the file in chrome://tracing or ui.perfetto.dev. */
+class Tracer {
+  inline static std::atomic<bool> s_enabled{false};
+
+  static void Record(const char* name, u32 chan, u64 startTicks, u64 endTicks);
+  friend class TraceSpan;
+
+public:
+  /** @brief Start recording to a file, replacing it.
+   *  A trace still running at process exit is stopped and its file finished then.
+   *  @param path Trace file to write.
+   *  @param options Buffer and flush settings.
+   *  @return false if the file could not be opened or tracing is already running. */
+  static bool Start(const char* path, const TracerOptions& options = {});
+
+  /** @brief Stop recording, flush remaining events and close the file. No-op if not started. */
+  static void Stop();
+
+  /** @brief Check if recording is in progress. */
+  static bool Enabled() { return s_enabled.load(std::memory_order_relaxed); }
+
+  /** @brief Get number of events dropped because a thread's buffer was full. */
+  static u64 GetDropped();
+};
+
+/** Records the lifetime of a scope as one trace span while jbus::Tracer is enabled. */
+class TraceSpan {
+  const char* m_name;
+  u64 m_startTicks = 0;
+  u32 m_chan;
+
+public:
+  /** @brief Begin span.
+   *  @param name Span name; must be a string literal or otherwise outlive the trace.
+   *  @param chan SI channel of the endpoint doing the work, shown as an event argument. */
+  TraceSpan(const char* name, u32 chan) : m_name(name), m_chan(chan) {
+    if (Tracer::Enabled())
+      m_startTicks = GetGCTicks();
+  }
+  ~TraceSpan() {
+    if (m_startTicks)
+      Tracer::Record(m_name, m_chan, m_startTicks, GetGCTicks());
+  }
+
+  TraceSpan(const TraceSpan&) = delete;
+  TraceSpan& operator=(const TraceSpan&) = delete;
+};
+
+} // namespace jbus
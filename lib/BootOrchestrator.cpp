@@ -0,0 +1,201 @@
+#include "jbus/BootOrchestrator.hpp"
+
+#include <algorithm>
+
+#include "jbus/Endpoint.hpp"
+#include "jbus/Listener.hpp"
+
+namespace jbus {
+
+BootOrchestrator::BootOrchestrator(const u8* programp, s32 length, s32 paletteColor, s32 paletteSpeed)
+: m_progPtr(programp)
+, m_progLen(length)
+, m_paletteColor(paletteColor)
+, m_paletteSpeed(paletteSpeed) {}
+
+BootOrchestrator::~BootOrchestrator() {
+  /* A JoyBoot still running completes into its Channel; stop the endpoints while the channels exist */
+  std::array<Endpoint*, 4> endpoints{};
+  for (size_t i = 0; i < m_channels.size(); ++i)
+    endpoints[i] = m_channels[i].endpoint.get();
+  Endpoint::StopAll(endpoints);
+}
+
+void BootOrchestrator::setProgram(const u8* programp, s32 length) {
+  m_progPtr = programp;
+  m_progLen = length;
+}
+
+int BootOrchestrator::addEndpoint(std::unique_ptr<Endpoint>&& endpoint) {
+  if (!endpoint)
+    return -1;
+
+  for (unsigned i = 0; i < m_channels.size(); ++i) {
+    Channel& ch = m_channels[i];
+    if (ch.endpoint)
+      continue;
+
+    endpoint->setChan(i);
+    ch.endpoint = std::move(endpoint);
+    ch.state = EChannelState::Waiting;
+    ch.result = -1;
+    ch.jstat = 0;
+    ch.percent = 0;
+    ch.bytesSent = 0;
+    ch.acceptTicks = GetGCTicks();
+    ch.startTicks = 0;
+    ch.endTicks = 0;
+    ch.joyBoot = {};
+    return int(i);
+  }
+
+  return -1;
+}
+
+unsigned BootOrchestrator::acceptFrom(Listener& listener) {
+  unsigned accepted = 0;
+  for (const Channel& ch : m_channels) {
+    if (ch.endpoint)
+      continue;
+    std::unique_ptr<Endpoint> endpoint = listener.accept();
+    if (!endpoint)
+      break;
+    addEndpoint(std::move(endpoint));
+    ++accepted;
+  }
+  return accepted;
+}
+
+void BootOrchestrator::startBoot(unsigned chan) {
+  Channel& ch = m_channels[chan];
+  ch.result = -1;
+  EJoyReturn ret = ch.endpoint->GBAJoyBootAsync(
+      m_paletteColor, m_paletteSpeed, m_progPtr, m_progLen, &ch.jstat,
+      [&ch](ThreadLocalEndpoint&, const JoyBootResult& result) {
+        /* Published by the result store; read only after pump() observes it */
+        ch.joyBoot = result;
+        ch.result.store(result.status);
+      });
+
+  switch (ret) {
+  case GBA_READY:
+    ch.state = EChannelState::Booting;
+    ch.startTicks = GetGCTicks();
+    if (!m_firstStartTicks)
+      m_firstStartTicks = ch.startTicks;
+    break;
+  case GBA_NOT_READY:
+    /* Endpoint busy; retry on next pump unless the link is gone */
+    if (!ch.endpoint->connected()) {
+      ch.result = GBA_NOT_READY;
+      ch.state = EChannelState::Failed;
+    }
+    break;
+  default:
+    ch.result = ret;
+    ch.state = EChannelState::Failed;
+    break;
+  }
+}
+
+void BootOrchestrator::pump() {
+  for (unsigned i = 0; i < m_channels.size(); ++i) {
+    Channel& ch = m_channels[i];
+    switch (ch.state) {
+    case EChannelState::Waiting:
+      if (GetGCTicks() - ch.acceptTicks >= m_settleTicks)
+        startBoot(i);
+      break;
+    case EChannelState::Booting: {
+      ProcessStatus status;
+      ch.endpoint->GBAGetProcessStatus(status);
+      ch.percent = status.percent;
+      if (status.phase == ProcessStatus::EPhase::Transfer || status.phase == ProcessStatus::EPhase::BootPoll)
+        ch.bytesSent = status.bytesSent;
+
+      /* A lost link completes the JoyBoot with GBA_NOT_READY too, so the result is the only signal;
+       * until it is stored the callback may still be writing ch.joyBoot */
+      const int result = ch.result.load();
+      if (result != -1) {
+        ch.endTicks = GetGCTicks();
+        /* The final count, padding and CRC included; kept in the total after the channel is released */
+        ch.bytesSent = ch.joyBoot.bytesSent;
+        m_finishedBytes += ch.bytesSent;
+        ch.state = result == GBA_READY ? EChannelState::Done : EChannelState::Failed;
+        m_lastEndTicks = std::max(m_lastEndTicks, ch.endTicks);
+      }
+      break;
+    }
+    default:
+      break;
+    }
+  }
+}
+
+BootOrchestrator::ChannelProgress BootOrchestrator::getProgress(unsigned chan) const {
+  ChannelProgress ret;
+  if (chan >= m_channels.size())
+    return ret;
+
+  const Channel& ch = m_channels[chan];
+  ret.state = ch.state;
+  int result = ch.result.load();
+  ret.status = result == -1 ? GBA_BUSY : EJoyReturn(result);
+  ret.percent = ch.state == EChannelState::Done ? 100 : ch.percent;
+  ret.bytesSent = ch.bytesSent;
+  ret.acceptTicks = ch.acceptTicks;
+  ret.startTicks = ch.startTicks;
+  ret.endTicks = ch.endTicks;
+  if (ch.state == EChannelState::Done || ch.state == EChannelState::Failed)
+    ret.joyBoot = ch.joyBoot;
+  return ret;
+}
+
+bool BootOrchestrator::allDone() const {
+  bool occupied = false;
+  for (const Channel& ch : m_channels) {
+    if (ch.state == EChannelState::Waiting || ch.state == EChannelState::Booting)
+      return false;
+    if (ch.state != EChannelState::Empty)
+      occupied = true;
+  }
+  return occupied;
+}
+
+double BootOrchestrator::getThroughput() const {
+  if (!m_firstStartTicks)
+    return 0.0;
+
+  u64 totalBytes = m_finishedBytes;
+  bool active = false;
+  for (const Channel& ch : m_channels) {
+    if (ch.state == EChannelState::Booting)
+      totalBytes += ch.bytesSent;
+    if (ch.state == EChannelState::Waiting || ch.state == EChannelState::Booting)
+      active = true;
+  }
+
+  /* Idle time after the last JoyBoot finished does not count against the rate */
+  u64 endTicks = active ? GetGCTicks() : m_lastEndTicks;
+  if (endTicks <= m_firstStartTicks)
+    return 0.0;
+
+  return double(totalBytes) * GetGCTicksPerSec() / double(endTicks - m_firstStartTicks);
+}
+
+Endpoint* BootOrchestrator::getEndpoint(unsigned chan) const {
+  if (chan >= m_channels.size())
+    return nullptr;
+  return m_channels[chan].endpoint.get();
+}
+
+std::unique_ptr<Endpoint> BootOrchestrator::releaseEndpoint(unsigned chan) {
+  if (chan >= m_channels.size() || m_channels[chan].state == EChannelState::Booting)
+    return nullptr;
+
+  Channel& ch = m_channels[chan];
+  ch.state = EChannelState::Empty;
+  return std::move(ch.endpoint);
+}
+
+} // namespace jbus
@@ -0,0 +1,128 @@
+#include "jbus/ChromeTrace.hpp"
+
+#include <cinttypes>
+#include <cstdio>
+
+#include "jbus/Endpoint.hpp"
+
+namespace jbus {
+
+namespace {
+void AppendEscaped(std::string& out, std::string_view str) {
+  for (char c : str) {
+    if (c == '"' || c == '\\')
+      out += '\\';
+    if (u8(c) < 0x20)
+      continue;
+    out += c;
+  }
+}
+
+void AppendMicros(std::string& out, u64 ticks) {
+  /* 486 ticks per microsecond; keep sub-microsecond precision for short events */
+  char buf[32];
+  snprintf(buf, sizeof(buf), "%.3f", ticks * 1000000.0 / GetGCTicksPerSec());
+  out += buf;
+}
+} // namespace
+
+void ChromeTraceWriter::beginEvent(std::string_view name, std::string_view category, char phase, u64 ticks, u32 pid,
+                                   u32 tid) {
+  if (!m_first)
+    m_json += ',';
+  m_first = false;
+
+  m_json += "\n{\"name\":\"";
+  AppendEscaped(m_json, name);
+  m_json += "\",\"cat\":\"";
+  AppendEscaped(m_json, category);
+  m_json += "\",\"ph\":\"";
+  m_json += phase;
+  m_json += "\",\"ts\":";
+  AppendMicros(m_json, ticks);
+  char ids[48];
+  snprintf(ids, sizeof(ids), ",\"pid\":%" PRIu32 ",\"tid\":%" PRIu32, pid, tid);
+  m_json += ids;
+}
+
+void ChromeTraceWriter::complete(std::string_view name, std::string_view category, u64 startTicks, u64 endTicks,
+                                 u32 pid, u32 tid, std::string_view args) {
+  beginEvent(name, category, 'X', startTicks, pid, tid);
+  m_json += ",\"dur\":";
+  AppendMicros(m_json, endTicks > startTicks ? endTicks - startTicks : 0);
+  if (!args.empty()) {
+    m_json += ",\"args\":{";
+    m_json += args;
+    m_json += '}';
+  }
+  m_json += '}';
+}
+
+void ChromeTraceWriter::instant(std::string_view name, std::string_view category, u64 ticks, u32 pid, u32 tid) {
+  beginEvent(name, category, 'i', ticks, pid, tid);
+  m_json += ",\"s\":\"t\"}";
+}
+
+void ChromeTraceWriter::threadName(u32 pid, u32 tid, std::string_view name) {
+  beginEvent("thread_name", "__metadata", 'M', 0, pid, tid);
+  m_json += ",\"args\":{\"name\":\"";
+  AppendEscaped(m_json, name);
+  m_json += "\"}}";
+}
+
+void ChromeTraceWriter::joyBoot(const JoyBootResult& result, u32 pid, u32 tid) {
+  char args[160];
+  snprintf(args, sizeof(args),
+           "\"status\":%d,\"chan\":%u,\"bytes\":%" PRIu32 ",\"commands\":%" PRIu32 ",\"hostUs\":%.1f", result.status,
+           result.chan, result.bytesSent, result.commands, result.hostTicks * 1000000.0 / GetGCTicksPerSec());
+  complete("joyboot", "joyboot", result.startTicks, result.endTicks, pid, tid, args);
+
+  /* Each phase runs from the previous milestone to its own; unreached phases are skipped */
+  struct Phase {
+    const char* name;
+    u64 begin;
+    u64 end;
+    bool polls;
+  };
+  const Phase phases[] = {
+      {"reset", result.startTicks, result.resetTicks, false},
+      {"status", result.resetTicks, result.statusTicks, false},
+      {"challenge read", result.statusTicks, result.challengeTicks, false},
+      {"key derivation", result.challengeTicks, result.keyTicks, false},
+      {"transmit", result.transmitStartTicks, result.transmitEndTicks, false},
+      {"boot poll", result.bootPollStartTicks, result.bootPollEndTicks, true},
+      {"acknowledge", result.bootPollEndTicks, result.acknowledgeTicks, false},
+  };
+  for (const Phase& phase : phases) {
+    if (!phase.begin || !phase.end)
+      continue;
+    if (phase.polls) {
+      snprintf(args, sizeof(args), "\"polls\":%" PRIu32, result.bootPolls);
+      complete(phase.name, "joyboot", phase.begin, phase.end, pid, tid, args);
+    } else {
+      complete(phase.name, "joyboot", phase.begin, phase.end, pid, tid);
+    }
+  }
+}
+
+std::string ChromeTraceWriter::drain() {
+  std::string ret = std::move(m_json);
+  m_json.clear();
+  return ret;
+}
+
+std::string ChromeTraceWriter::finish() {
+  m_json += "\n]}\n";
+  return std::move(m_json);
+}
+
+bool ChromeTraceWriter::write(const char* path) {
+  std::string json = finish();
+  FILE* fp = fopen(path, "wb");
+  if (!fp)
+    return false;
+  bool ok = fwrite(json.data(), 1, json.size(), fp) == json.size();
+  return fclose(fp) == 0 && ok;
+}
+
+} // namespace jbus
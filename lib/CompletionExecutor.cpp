@@ -0,0 +1,126 @@
+#include "jbus/CompletionExecutor.hpp"
+
+#include <algorithm>
+
+namespace jbus {
+
+void CompletionExecutor::enqueue(Strand& strand, unsigned worker) {
+  {
+    std::unique_lock<std::mutex> lk(m_workers[worker]->lock);
+    m_workers[worker]->ready.push_back(&strand);
+  }
+  {
+    std::unique_lock<std::mutex> lk(m_sleepLock);
+    ++m_readyCount;
+  }
+  m_sleepCv.notify_one();
+}
+
+CompletionExecutor::Strand* CompletionExecutor::dequeue(unsigned worker) {
+  /* Own queue is consumed from the front to preserve scheduling order */
+  {
+    Worker& self = *m_workers[worker];
+    std::unique_lock<std::mutex> lk(self.lock);
+    if (!self.ready.empty()) {
+      Strand* ret = self.ready.front();
+      self.ready.pop_front();
+      return ret;
+    }
+  }
+
+  /* Steal from the back of another worker's queue */
+  for (unsigned i = 1; i < m_workers.size(); ++i) {
+    Worker& victim = *m_workers[(worker + i) % m_workers.size()];
+    std::unique_lock<std::mutex> lk(victim.lock);
+    if (!victim.ready.empty()) {
+      Strand* ret = victim.ready.back();
+      victim.ready.pop_back();
+      return ret;
+    }
+  }
+
+  return nullptr;
+}
+
+void CompletionExecutor::runStrand(Strand& strand, unsigned worker) {
+  for (unsigned i = 0; i < StrandBatch; ++i) {
+    std::function<void()> task;
+    {
+      std::unique_lock<std::mutex> lk(strand.m_lock);
+      if (strand.m_tasks.empty()) {
+        strand.m_scheduled = false;
+        strand.m_idleCv.notify_all();
+        return;
+      }
+      task = std::move(strand.m_tasks.front());
+      strand.m_tasks.pop_front();
+    }
+    task();
+  }
+
+  /* Yield to other strands; this one stays scheduled */
+  enqueue(strand, worker);
+}
+
+void CompletionExecutor::workerProc(unsigned worker) {
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lk(m_sleepLock);
+      m_sleepCv.wait(lk, [this]() { return m_readyCount || !m_running; });
+      if (!m_readyCount)
+        break;
+      --m_readyCount;
+    }
+
+    /* A ready count was claimed, so a strand is queued somewhere */
+    Strand* strand;
+    while (!(strand = dequeue(worker)))
+      std::this_thread::yield();
+    runStrand(*strand, worker);
+  }
+}
+
+CompletionExecutor::CompletionExecutor(unsigned threadCount) {
+  if (!threadCount)
+    threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+  m_workers.reserve(threadCount);
+  for (unsigned i = 0; i < threadCount; ++i)
+    m_workers.push_back(std::make_unique<Worker>());
+  for (unsigned i = 0; i < threadCount; ++i)
+    m_workers[i]->thread = std::thread(&CompletionExecutor::workerProc, this, i);
+}
+
+CompletionExecutor::~CompletionExecutor() {
+  {
+    std::unique_lock<std::mutex> lk(m_sleepLock);
+    m_running = false;
+  }
+  m_sleepCv.notify_all();
+  for (auto& worker : m_workers)
+    if (worker->thread.joinable())
+      worker->thread.join();
+}
+
+std::unique_ptr<CompletionExecutor::Strand> CompletionExecutor::makeStrand() {
+  return std::make_unique<Strand>(m_nextHome++ % m_workers.size());
+}
+
+void CompletionExecutor::post(Strand& strand, std::function<void()>&& task) {
+  bool schedule;
+  {
+    std::unique_lock<std::mutex> lk(strand.m_lock);
+    strand.m_tasks.push_back(std::move(task));
+    schedule = !strand.m_scheduled;
+    strand.m_scheduled = true;
+  }
+  if (schedule)
+    enqueue(strand, strand.m_home);
+}
+
+void CompletionExecutor::drain(Strand& strand) {
+  std::unique_lock<std::mutex> lk(strand.m_lock);
+  strand.m_idleCv.wait(lk, [&strand]() { return !strand.m_scheduled; });
+}
+
+} // namespace jbus
@@ -0,0 +1,121 @@
+#include "jbus/Coroutine.hpp"
+
+#include <new>
+
+#include "jbus/Endpoint.hpp"
+
+namespace jbus {
+
+namespace {
+/* Header preceding every frame, recording which pool (if any) owns it */
+struct alignas(std::max_align_t) FrameHeader {
+  FramePool* pool;
+};
+
+/* ThreadLocalEndpoint of the callback currently resuming a coroutine on this thread */
+thread_local ThreadLocalEndpoint* CurrentLocal = nullptr;
+} // namespace
+
+FramePool::~FramePool() {
+  for (Block* block : m_free) {
+    while (block) {
+      Block* next = block->next;
+      ::operator delete(block);
+      block = next;
+    }
+  }
+}
+
+void* FramePool::Allocate(FramePool* pool, size_t size) {
+  size_t total = sizeof(FrameHeader) + size;
+  size_t sizeClass = (total + Granularity - 1) / Granularity;
+  if (pool && sizeClass < ClassCount) {
+    total = sizeClass * Granularity;
+    std::unique_lock<std::mutex> lk(pool->m_lock);
+    if (Block* block = pool->m_free[sizeClass]) {
+      pool->m_free[sizeClass] = block->next;
+      lk.unlock();
+      auto* header = reinterpret_cast<FrameHeader*>(block);
+      header->pool = pool;
+      return header + 1;
+    }
+  } else {
+    pool = nullptr;
+  }
+
+  auto* header = static_cast<FrameHeader*>(::operator new(total));
+  header->pool = pool;
+  return header + 1;
+}
+
+void FramePool::Deallocate(void* ptr, size_t size) {
+  auto* header = static_cast<FrameHeader*>(ptr) - 1;
+  FramePool* pool = header->pool;
+  if (!pool) {
+    ::operator delete(header);
+    return;
+  }
+
+  size_t sizeClass = (sizeof(FrameHeader) + size + Granularity - 1) / Granularity;
+  auto* block = reinterpret_cast<Block*>(header);
+  std::unique_lock<std::mutex> lk(pool->m_lock);
+  block->next = pool->m_free[sizeClass];
+  pool->m_free[sizeClass] = block;
+}
+
+FramePool& GetFramePool(Endpoint& endpoint) { return endpoint.m_framePool; }
+
+template <typename EP>
+EJoyReturn CommandAwaiter::submit(EP& ep) {
+  auto resume = [this](ThreadLocalEndpoint& endpoint, EJoyReturn status) {
+    m_result.status = status;
+    ThreadLocalEndpoint* prevLocal = CurrentLocal;
+    CurrentLocal = &endpoint;
+    /* This awaiter may be destroyed once the coroutine resumes */
+    m_handle.resume();
+    CurrentLocal = prevLocal;
+  };
+  auto resumeBlock = [this](ThreadLocalEndpoint& endpoint, EJoyReturn status, size_t transferred) {
+    m_result.status = status;
+    m_result.transferred = transferred;
+    ThreadLocalEndpoint* prevLocal = CurrentLocal;
+    CurrentLocal = &endpoint;
+    m_handle.resume();
+    CurrentLocal = prevLocal;
+  };
+
+  switch (m_kind) {
+  case EKind::Status:
+    return ep.GBAGetStatusAsync(&m_result.jstat, resume, m_lane);
+  case EKind::Reset:
+    return ep.GBAResetAsync(&m_result.jstat, resume, m_lane);
+  case EKind::Read:
+    return ep.GBAReadAsync(m_result.data, &m_result.jstat, resume, m_lane);
+  case EKind::Write:
+    return ep.GBAWriteAsync(m_word, &m_result.jstat, resume, m_lane);
+  case EKind::ReadBlock:
+    return ep.GBAReadBlockAsync(m_dst, &m_result.jstat, resumeBlock, m_gate);
+  case EKind::WriteBlock:
+    return ep.GBAWriteBlockAsync(m_src, &m_result.jstat, resumeBlock, m_gate);
+  case EKind::JoyBoot:
+    return ep.GBAJoyBootAsync(m_paletteColor, m_paletteSpeed, m_src.data(), s32(m_src.size()), &m_result.jstat,
+                              resume);
+  default:
+    return GBA_JOYBOOT_ERR_INVALID;
+  }
+}
+
+bool CommandAwaiter::await_suspend(std::coroutine_handle<> handle) {
+  m_handle = handle;
+
+  /* Coroutines resumed from a callback of this endpoint chain without locking */
+  ThreadLocalEndpoint* local = CurrentLocal;
+  EJoyReturn status = (local && &local->m_ep == &m_ep) ? submit(*local) : submit(m_ep);
+  if (status == GBA_READY)
+    return true;
+
+  m_result.status = status;
+  return false;
+}
+
+} // namespace jbus
@@ -1,6 +1,10 @@
 #include "jbus/Endpoint.hpp"
 
 #include <algorithm>
+#include <chrono>
+
+#include "jbus/Tracer.hpp"
+#include "Probes.hpp"
 
 #define LOG_TRANSFER 0
 
@@ -45,55 +49,52 @@ void Endpoint::KawasedoChallenge::DSPSecParms::ProcessGBACrypto() {
 }
 
 void Endpoint::KawasedoChallenge::_0Reset(ThreadLocalEndpoint& endpoint, EJoyReturn status) {
+  ++m_result.commands;
   if (status != GBA_READY ||
       (status = endpoint.GBAResetAsync(x10_statusPtr, bindThis(&KawasedoChallenge::_1GetStatus))) != GBA_READY) {
-    x28_ticksAfterXf = 0;
-    if (x14_callback) {
-      x14_callback(endpoint, status);
-      x14_callback = {};
-    }
+    _finish(endpoint, status);
   }
 }
 
 void Endpoint::KawasedoChallenge::_1GetStatus(ThreadLocalEndpoint& endpoint, EJoyReturn status) {
+  ++m_result.commands;
+  m_result.resetTicks = GetGCTicks();
+  JBUS_PROBE3(joyboot_phase, endpoint.getChan(), JOYBOOT_PROBE_RESET, 0);
   if (status == GBA_READY)
     if (*x10_statusPtr != GBA_JSTAT_SEND)
       status = GBA_JOYBOOT_UNKNOWN_STATE;
 
   if (status != GBA_READY || (status = endpoint.GBAGetStatusAsync(
                                   x10_statusPtr, bindThis(&KawasedoChallenge::_2ReadChallenge))) != GBA_READY) {
-    x28_ticksAfterXf = 0;
-    if (x14_callback) {
-      x14_callback(endpoint, status);
-      x14_callback = {};
-    }
+    _finish(endpoint, status);
   }
 }
 
 void Endpoint::KawasedoChallenge::_2ReadChallenge(ThreadLocalEndpoint& endpoint, EJoyReturn status) {
+  ++m_result.commands;
+  m_result.statusTicks = GetGCTicks();
+  JBUS_PROBE3(joyboot_phase, endpoint.getChan(), JOYBOOT_PROBE_STATUS, 0);
   if (status == GBA_READY)
     if (*x10_statusPtr != (GBA_JSTAT_PSF0 | GBA_JSTAT_SEND))
       status = GBA_JOYBOOT_UNKNOWN_STATE;
 
   if (status != GBA_READY || (status = endpoint.GBAReadAsync(x18_readBuf, x10_statusPtr,
                                                              bindThis(&KawasedoChallenge::_3DSPCrypto))) != GBA_READY) {
-    x28_ticksAfterXf = 0;
-    if (x14_callback) {
-      x14_callback(endpoint, status);
-      x14_callback = {};
-    }
+    _finish(endpoint, status);
   }
 }
 
 void Endpoint::KawasedoChallenge::_3DSPCrypto(ThreadLocalEndpoint& endpoint, EJoyReturn status) {
+  ++m_result.commands;
+  m_result.challengeTicks = GetGCTicks();
+  JBUS_PROBE3(joyboot_phase, endpoint.getChan(), JOYBOOT_PROBE_CHALLENGE, 0);
   if (status != GBA_READY) {
-    x28_ticksAfterXf = 0;
-    if (x14_callback) {
-      x14_callback(endpoint, status);
-      x14_callback = {};
-    }
+    _finish(endpoint, status);
   } else {
     _DSPCryptoInit();
+    m_result.keyTicks = GetGCTicks();
+    m_result.hostTicks += m_result.keyTicks - m_result.challengeTicks;
+    JBUS_PROBE3(joyboot_phase, endpoint.getChan(), JOYBOOT_PROBE_KEY, 0);
     _DSPCryptoDone(endpoint);
   }
 }
@@ -123,26 +124,22 @@ void Endpoint::KawasedoChallenge::_DSPCryptoDone(ThreadLocalEndpoint& endpoint)
   x34_bytesSent = 0;
 
   x28_ticksAfterXf = GetGCTicks();
+  m_result.transmitStartTicks = x28_ticksAfterXf;
+  JBUS_PROBE3(joyboot_phase, endpoint.getChan(), JOYBOOT_PROBE_TRANSMIT_START, 0);
   x30_justStarted = 1;
 
   EJoyReturn status;
   if ((status = endpoint.GBAWriteAsync(x1c_writeBuf, x10_statusPtr, bindThis(&KawasedoChallenge::_4TransmitProgram))) !=
       GBA_READY) {
-    x28_ticksAfterXf = 0;
-    if (x14_callback) {
-      x14_callback(endpoint, status);
-      x14_callback = {};
-    }
+    _finish(endpoint, status);
   }
 }
 
 void Endpoint::KawasedoChallenge::_4TransmitProgram(ThreadLocalEndpoint& endpoint, EJoyReturn status) {
+  u64 entryTicks = GetGCTicks();
+  ++m_result.commands;
   if (status != GBA_READY) {
-    x28_ticksAfterXf = 0;
-    if (x14_callback) {
-      x14_callback(endpoint, status);
-      x14_callback = {};
-    }
+    _finish(endpoint, status);
     return;
   }
 
@@ -153,11 +150,7 @@ void Endpoint::KawasedoChallenge::_4TransmitProgram(ThreadLocalEndpoint& endpoin
     x30_justStarted = 0;
   } else {
     if (!(*x10_statusPtr & GBA_JSTAT_PSF1) || (*x10_statusPtr & GBA_JSTAT_PSF0) >> 4 != (x34_bytesSent & 4) >> 2) {
-      x28_ticksAfterXf = 0;
-      if (x14_callback) {
-        x14_callback(endpoint, GBA_JOYBOOT_UNKNOWN_STATE);
-        x14_callback = {};
-      }
+      _finish(endpoint, GBA_JOYBOOT_UNKNOWN_STATE);
       return;
     }
     x34_bytesSent += 4;
@@ -232,98 +225,99 @@ void Endpoint::KawasedoChallenge::_4TransmitProgram(ThreadLocalEndpoint& endpoin
           x3c_checkStore[-1 + x20_byteInWindow] * x3c_checkStore[4 - x20_byteInWindow];
     }
 
+    m_result.hostTicks += GetGCTicks() - entryTicks;
     if ((status = endpoint.GBAWriteAsync(x1c_writeBuf, x10_statusPtr,
                                          bindThis(&KawasedoChallenge::_4TransmitProgram))) != GBA_READY) {
-      x28_ticksAfterXf = 0;
-      if (x14_callback) {
-        x14_callback(endpoint, status);
-        x14_callback = {};
-      }
+      _finish(endpoint, status);
     }
   } else // x34_bytesWritten > x64_totalBytes
   {
+    m_result.transmitEndTicks = entryTicks;
+    JBUS_PROBE3(joyboot_phase, endpoint.getChan(), JOYBOOT_PROBE_TRANSMIT_END, x34_bytesSent);
     if ((status = endpoint.GBAReadAsync(x18_readBuf, x10_statusPtr, bindThis(&KawasedoChallenge::_5StartBootPoll))) !=
         GBA_READY) {
-      x28_ticksAfterXf = 0;
-      if (x14_callback) {
-        x14_callback(endpoint, status);
-        x14_callback = {};
-      }
+      _finish(endpoint, status);
     }
   }
 }
 
 void Endpoint::KawasedoChallenge::_5StartBootPoll(ThreadLocalEndpoint& endpoint, EJoyReturn status) {
+  ++m_result.commands;
+  m_result.bootPollStartTicks = GetGCTicks();
+  JBUS_PROBE3(joyboot_phase, endpoint.getChan(), JOYBOOT_PROBE_BOOT_POLL, bytesSent());
+  ++m_result.bootPolls;
   if (status != GBA_READY ||
       (status = endpoint.GBAGetStatusAsync(x10_statusPtr, bindThis(&KawasedoChallenge::_6BootPoll))) != GBA_READY) {
-    x28_ticksAfterXf = 0;
-    if (x14_callback) {
-      x14_callback(endpoint, status);
-      x14_callback = {};
-    }
+    _finish(endpoint, status);
   }
 }
 
 void Endpoint::KawasedoChallenge::_6BootPoll(ThreadLocalEndpoint& endpoint, EJoyReturn status) {
+  ++m_result.commands;
   if (status == GBA_READY)
     if (*x10_statusPtr & (GBA_JSTAT_FLAGS_MASK | GBA_JSTAT_RECV))
       status = GBA_JOYBOOT_UNKNOWN_STATE;
 
   if (status != GBA_READY) {
-    x28_ticksAfterXf = 0;
-    if (x14_callback) {
-      x14_callback(endpoint, status);
-      x14_callback = {};
-    }
+    _finish(endpoint, status);
     return;
   }
 
   if (*x10_statusPtr != GBA_JSTAT_SEND) {
+    ++m_result.bootPolls;
     if ((status = endpoint.GBAGetStatusAsync(x10_statusPtr, bindThis(&KawasedoChallenge::_6BootPoll))) != GBA_READY) {
-      x28_ticksAfterXf = 0;
-      if (x14_callback) {
-        x14_callback(endpoint, status);
-        x14_callback = {};
-      }
+      _finish(endpoint, status);
     }
     return;
   }
 
+  m_result.bootPollEndTicks = GetGCTicks();
+  JBUS_PROBE3(joyboot_phase, endpoint.getChan(), JOYBOOT_PROBE_ACKNOWLEDGE, bytesSent());
   if ((status = endpoint.GBAReadAsync(x18_readBuf, x10_statusPtr, bindThis(&KawasedoChallenge::_7BootAcknowledge))) !=
       GBA_READY) {
-    x28_ticksAfterXf = 0;
-    if (x14_callback) {
-      x14_callback(endpoint, status);
-      x14_callback = {};
-    }
+    _finish(endpoint, status);
   }
 }
 
 void Endpoint::KawasedoChallenge::_7BootAcknowledge(ThreadLocalEndpoint& endpoint, EJoyReturn status) {
+  ++m_result.commands;
   if (status != GBA_READY || (status = endpoint.GBAWriteAsync(x18_readBuf, x10_statusPtr,
                                                               bindThis(&KawasedoChallenge::_8BootDone))) != GBA_READY) {
-    x28_ticksAfterXf = 0;
-    if (x14_callback) {
-      x14_callback(endpoint, status);
-      x14_callback = {};
-    }
+    _finish(endpoint, status);
   }
 }
 
 void Endpoint::KawasedoChallenge::_8BootDone(ThreadLocalEndpoint& endpoint, EJoyReturn status) {
+  ++m_result.commands;
+  m_result.acknowledgeTicks = GetGCTicks();
   if (status == GBA_READY)
     *x10_statusPtr = 0;
 
-  x28_ticksAfterXf = 0;
+  _finish(endpoint, status);
+}
 
+void Endpoint::KawasedoChallenge::_finish(ThreadLocalEndpoint& endpoint, EJoyReturn status) {
+  x28_ticksAfterXf = 0;
+  m_result.status = status;
+  m_result.chan = u8(endpoint.getChan());
+  m_result.bytesSent = bytesSent();
+  m_result.endTicks = GetGCTicks();
+  JBUS_PROBE3(joyboot_phase, endpoint.getChan(), JOYBOOT_PROBE_FINISH, m_result.bytesSent);
+
+  /* The callback may start another JoyBoot over this object; release it and the result first */
+  m_done = true;
   if (x14_callback) {
-    x14_callback(endpoint, status);
+    FGBAJoyBootCallback callback = std::move(x14_callback);
     x14_callback = {};
+    JoyBootResult result = m_result;
+    /* The user's own submissions are no JoyBoot steps */
+    ThreadLocalEndpoint userEndpoint(endpoint.m_ep, endpoint.m_deferred);
+    callback(userEndpoint, result);
   }
 }
 
 Endpoint::KawasedoChallenge::KawasedoChallenge(s32 paletteColor, s32 paletteSpeed, const u8* programp, s32 length,
-                                               u8* status, FGBACallback&& callback)
+                                               u8* status, FGBAJoyBootCallback&& callback)
 : x0_pColor(paletteColor)
 , x4_pSpeed(paletteSpeed)
 , x8_progPtr(programp)
@@ -331,16 +325,59 @@ Endpoint::KawasedoChallenge::KawasedoChallenge(s32 paletteColor, s32 paletteSpee
 , x10_statusPtr(status)
 , x14_callback(std::move(callback))
 , x34_bytesSent(0)
+, x64_totalBytes(0)
 , m_initialized(true) {}
 
-void Endpoint::KawasedoChallenge::start(Endpoint& endpoint) {
+void Endpoint::KawasedoChallenge::start(ThreadLocalEndpoint& endpoint) {
+  m_result.startTicks = GetGCTicks();
+  JBUS_PROBE3(joyboot_phase, endpoint.getChan(), JOYBOOT_PROBE_START, 0);
   if (endpoint.GBAGetStatusAsync(x10_statusPtr, bindThis(&KawasedoChallenge::_0Reset)) != GBA_READY) {
     x14_callback = {};
     m_started = false;
+    m_done = true;
   }
 }
 
+void Endpoint::configureSockets() {
+  if (m_socketOptions) {
+    m_dataSocket.applyOptions(*m_socketOptions);
+    m_clockSocket.applyOptions(*m_socketOptions);
+  }
+  if (m_conditionerOptions) {
+    net::LinkConditionerOptions clockConditioner = *m_conditionerOptions;
+    ++clockConditioner.seed;
+    m_dataSocket.setConditioner(*m_conditionerOptions);
+    m_clockSocket.setConditioner(clockConditioner);
+    /* process() must not sleep on held bytes; have the conditioner report Busy instead */
+    if (m_polled)
+      m_dataSocket.setBlocking(false);
+  }
+}
+
+void Endpoint::dropLink() {
+  m_running = false;
+  /* The peer sees the hang-up at once rather than on its own timeout */
+  std::unique_lock<std::mutex> socketLk(m_socketLock);
+  m_dataSocket.shutdown();
+  m_clockSocket.shutdown();
+}
+
+void Endpoint::recordResponse(u64 startTicks, u64 endTicks) {
+  const u64 rtt = endTicks - startTicks;
+  m_health.lastRttTicks = rtt;
+  if (!m_health.lastResponseTicks) {
+    m_health.smoothedRttTicks = rtt;
+    m_health.minRttTicks = rtt;
+  } else {
+    m_health.smoothedRttTicks = (m_health.smoothedRttTicks * 7 + rtt) / 8;
+    m_health.minRttTicks = std::min(m_health.minRttTicks, rtt);
+  }
+  m_health.maxRttTicks = std::max(m_health.maxRttTicks, rtt);
+  m_health.lastResponseTicks = endTicks;
+}
+
 void Endpoint::clockSync() {
+  TraceSpan span("clock sync", getChan());
   if (!m_clockSocket) {
     m_running = false;
     return;
@@ -356,16 +393,18 @@ void Endpoint::clockSync() {
   /* Scale GameCube clock into GBA clock */
   TickDelta = u32(u64(TickDelta) * 16777216 / GetGCTicksPerSec());
   m_lastGCTick = GetGCTicks();
+  JBUS_PROBE2(clock_sync, getChan(), TickDelta);
   TickDelta = SBig(TickDelta);
   if (m_clockSocket.send(&TickDelta, 4) == net::Socket::EResult::Error)
     m_running = false;
 }
 
 void Endpoint::send(Buffer buffer) {
+  TraceSpan span("send", getChan());
   m_lastCmd = buffer[0];
 
   net::Socket::EResult result;
-  size_t sentBytes;
+  size_t sentBytes = 0;
   if (m_lastCmd == CMD_WRITE) {
     result = m_dataSocket.send(buffer.data(), buffer.size(), sentBytes);
   } else {
@@ -376,6 +415,7 @@ void Endpoint::send(Buffer buffer) {
     m_booted = true;
   }
 
+  JBUS_PROBE3(send, getChan(), m_lastCmd, sentBytes);
   if (result != net::Socket::EResult::OK) {
     m_running = false;
   }
@@ -387,21 +427,39 @@ void Endpoint::send(Buffer buffer) {
 }
 
 size_t Endpoint::receive(Buffer& buffer) {
+  TraceSpan span("receive", getChan());
   if (!m_dataSocket) {
     m_running = false;
     return buffer.size();
   }
 
+  /* TCP may split a response across reads, notably over real networks or a LinkConditioner */
+  const size_t expected = ResponseSize(m_lastCmd);
+  const u64 deadline = m_responseTimeoutTicks ? GetGCTicks() + m_responseTimeoutTicks : 0;
   size_t recvBytes = 0;
-  const net::Socket::EResult result = m_dataSocket.recv(buffer.data(), buffer.size(), recvBytes);
-  if (result == net::Socket::EResult::Error) {
-    m_running = false;
-    return buffer.size();
-  }
-
-  if (recvBytes > buffer.size()) {
-    recvBytes = buffer.size();
+  while (recvBytes < expected) {
+    if (deadline) {
+      const u64 now = GetGCTicks();
+      const net::Socket* dataSocket = &m_dataSocket;
+      if (now >= deadline ||
+          !net::Socket::WaitReadable(&dataSocket, 1, u32((deadline - now) * 1000 / GetGCTicksPerSec() + 1))) {
+        m_responseTimedOut = true;
+        dropLink();
+        return buffer.size();
+      }
+    }
+    size_t received = 0;
+    const net::Socket::EResult result =
+        m_dataSocket.recv(buffer.data() + recvBytes, expected - recvBytes, received);
+    if (result == net::Socket::EResult::Error) {
+      m_running = false;
+      return buffer.size();
+    }
+    if (result != net::Socket::EResult::OK)
+      break;
+    recvBytes += received;
   }
+  JBUS_PROBE4(receive, getChan(), m_lastCmd, recvBytes, expected);
 
 #if LOG_TRANSFER
   if (recvBytes > 0) {
@@ -422,18 +480,103 @@ size_t Endpoint::runBuffer(Buffer& buffer, std::unique_lock<std::mutex>& lk) {
   Buffer tmpBuffer = buffer;
 
   lk.unlock();
+  const u64 startTicks = GetGCTicks();
   clockSync();
   send(tmpBuffer);
   const size_t receivedBytes = receive(tmpBuffer);
-  lk.lock();
+  const u64 endTicks = GetGCTicks();
+  {
+    TraceSpan span("lock wait", getChan());
+    lk.lock();
+  }
 
+  m_lastIoTicks = endTicks;
+  if (m_responseTimedOut) {
+    m_responseTimedOut = false;
+    ++m_health.timeouts;
+  } else if (m_running && receivedBytes) {
+    recordResponse(startTicks, endTicks);
+  }
   buffer = tmpBuffer;
   return receivedBytes;
 }
 
 bool Endpoint::idleGetStatus(std::unique_lock<std::mutex>& lk) {
   Buffer buffer{u8(CMD_STATUS), 0, 0, 0, 0};
-  return runBuffer(buffer, lk) != 0;
+  if (runBuffer(buffer, lk) == 0)
+    return false;
+
+  m_lastJStat = buffer[2];
+  publishStatus();
+  return true;
+}
+
+Endpoint::CommandSlot* Endpoint::nextIssued() {
+  for (CommandSlot& slot : m_lanes)
+    if (slot.issued)
+      return &slot;
+  return nullptr;
+}
+
+bool Endpoint::buildBlockCycle(Buffer& buffer) const {
+  const bool writing = m_block.src != nullptr;
+
+  /* GBA_JSTAT_RECV stays set until the GBA consumes a written word,
+   * GBA_JSTAT_SEND is set once the GBA has a word ready to be read */
+  const u8 gateMask = writing ? GBA_JSTAT_RECV : GBA_JSTAT_SEND;
+  const u8 gateReady = writing ? 0 : GBA_JSTAT_SEND;
+  buffer = {};
+  if (m_block.gate && (!m_block.jstatValid || (m_block.jstat & gateMask) != gateReady)) {
+    buffer[0] = CMD_STATUS;
+    return false;
+  }
+
+  const size_t wordBytes = std::min<size_t>(4, m_block.length - m_block.transferred);
+  if (writing) {
+    buffer[0] = CMD_WRITE;
+    std::copy(m_block.src + m_block.transferred, m_block.src + m_block.transferred + wordBytes, buffer.begin() + 1);
+  } else {
+    buffer[0] = CMD_READ;
+  }
+  return true;
+}
+
+bool Endpoint::completeBlockCycle(bool word, const Buffer& buffer) {
+  if (!word) {
+    m_block.jstat = buffer[2];
+    m_block.jstatValid = true;
+    m_lastJStat = m_block.jstat;
+    return false;
+  }
+
+  const bool writing = m_block.src != nullptr;
+  const size_t wordBytes = std::min<size_t>(4, m_block.length - m_block.transferred);
+  if (writing) {
+    m_block.jstat = buffer[0];
+  } else {
+    std::copy(buffer.cbegin(), buffer.cbegin() + wordBytes, m_block.dst + m_block.transferred);
+    m_block.jstat = buffer[4];
+  }
+  m_block.jstatValid = true;
+  m_lastJStat = m_block.jstat;
+  if (u8* statusPtr = laneSlot(EJoyLane::Bulk).statusPtr)
+    *statusPtr = m_block.jstat;
+
+  m_block.transferred += wordBytes;
+  publishProgress();
+  return m_block.transferred >= m_block.length;
+}
+
+bool Endpoint::runBlockCycle(std::unique_lock<std::mutex>& lk) {
+  if (m_block.transferred >= m_block.length)
+    return true;
+
+  Buffer buffer;
+  const bool word = buildBlockCycle(buffer);
+  runBuffer(buffer, lk);
+  if (!m_running)
+    return true;
+  return completeBlockCycle(word, buffer);
 }
 
 void Endpoint::transferProc() {
@@ -443,265 +586,856 @@ void Endpoint::transferProc() {
 
   /* This lock is relinquished on I/O cycles or when waiting for next request */
   std::unique_lock<std::mutex> lk(m_syncLock);
-  while (m_running) {
-    if (m_cmdIssued) {
-      /* Synchronous command write/read cycle */
-      runBuffer(m_buffer, lk);
-      m_cmdIssued = false;
-
-      EJoyReturn xferStatus = m_running ? GBA_READY : GBA_NOT_READY;
-
-      /* Handle message response */
-      switch (m_lastCmd) {
-      case CMD_RESET:
-      case CMD_STATUS:
-        if (m_statusPtr)
-          *m_statusPtr = m_buffer[2];
-        break;
-      case CMD_WRITE:
-        if (m_statusPtr)
-          *m_statusPtr = m_buffer[0];
-        break;
-      case CMD_READ:
-        if (m_statusPtr != nullptr) {
-          *m_statusPtr = m_buffer[4];
+  for (;;) {
+    while (m_running) {
+      if (CommandSlot* slot = nextIssued()) {
+        if (slot == &laneSlot(EJoyLane::Bulk) && m_blockIssued) {
+          /* One block cycle at a time, so higher lanes cut in between words; completing once */
+          if (runBlockCycle(lk))
+            finishBlock(m_running ? GBA_READY : GBA_NOT_READY);
+        } else {
+          /* Synchronous command write/read cycle */
+          runBuffer(slot->buffer, lk);
+          finishCommand(*slot, m_running ? GBA_READY : GBA_NOT_READY);
         }
-        if (m_readDstPtr != nullptr) {
-          std::copy(m_buffer.cbegin(), m_buffer.cbegin() + 4, m_readDstPtr);
+      } else if (!m_booted) {
+        /* Poll bus with status messages when inactive */
+        if (idleGetStatus(lk)) {
+          /* Woken early by a new request or requestStop() */
+          m_issueCv.wait_for(lk, std::chrono::microseconds(1000000 * 4 / 60),
+                             [this]() { return nextIssued() || !m_running; });
         }
-        break;
-      default:
-        break;
+      } else if (m_keepaliveTicks) {
+        /* Probe an idle booted link so a vanished peer surfaces before the next real command */
+        const u64 now = GetGCTicks();
+        if (keepaliveDue(now)) {
+          ++m_health.keepalives;
+          idleGetStatus(lk);
+        } else {
+          const u64 waitTicks = m_lastIoTicks + m_keepaliveTicks - now;
+          m_issueCv.wait_for(lk, std::chrono::microseconds(waitTicks * 1000000 / GetGCTicksPerSec() + 1),
+                             [this]() { return nextIssued() || !m_running; });
+        }
+      } else {
+        /* Wait for next user request */
+        m_issueCv.wait(lk, [this]() { return nextIssued() || !m_running; });
       }
+    }
 
-      m_statusPtr = nullptr;
-      m_readDstPtr = nullptr;
-      if (m_callback) {
-        FGBACallback cb = std::move(m_callback);
-        m_callback = {};
-        ThreadLocalEndpoint ep(*this);
-        cb(ep, xferStatus);
-      }
-    } else if (!m_booted) {
-      /* Poll bus with status messages when inactive */
-      if (idleGetStatus(lk)) {
-        lk.unlock();
-        WaitGCTicks(GetGCTicksPerSec() * 4 / 60);
-        lk.lock();
-      }
-    } else {
-      /* Wait for next user request */
-      m_issueCv.wait(lk);
+    /* Operations still waiting on other lanes complete too, so synchronous submitters wake */
+    failPending();
+
+    /* Sockets stay open until stop() joins or reattach() replaces them, so requestStop()
+     * may shut them down without racing a close */
+    m_detached = true;
+    publishStatus();
+    m_syncCv.notify_all();
+    if (m_stopRequested)
+      break;
+
+    ++m_health.disconnects;
+    if (m_disconnectCallback) {
+      FGBADisconnectCallback callback = m_disconnectCallback;
+      lk.unlock();
+      callback(*this);
+      lk.lock();
     }
+
+    /* Park until reattach() brings the link back up */
+    m_issueCv.wait(lk, [this]() { return m_running || m_stopRequested; });
+    if (m_stopRequested)
+      break;
   }
 
+  /* Whatever slipped in while the lock was released for the disconnect callback still completes */
+  failPending();
+  publishStatus();
   m_syncCv.notify_all();
-  m_dataSocket.close();
-  m_clockSocket.close();
 
 #if LOG_TRANSFER
   printf("Stopping JoyBus transfer thread for channel %d\n", m_chan);
 #endif
 }
 
+void Endpoint::finishCommand(CommandSlot& slot, EJoyReturn xferStatus) {
+  slot.issued = false;
+  ++slot.completions;
+  const bool joyBootStep = slot.joyBootStep;
+  slot.joyBootStep = false;
+
+  /* Handle message response */
+  const Buffer& buffer = slot.buffer;
+  switch (m_lastCmd) {
+  case CMD_RESET:
+  case CMD_STATUS:
+    m_lastJStat = buffer[2];
+    if (slot.statusPtr)
+      *slot.statusPtr = buffer[2];
+    break;
+  case CMD_WRITE:
+    m_lastJStat = buffer[0];
+    if (slot.statusPtr)
+      *slot.statusPtr = buffer[0];
+    break;
+  case CMD_READ:
+    m_lastJStat = buffer[4];
+    if (slot.statusPtr != nullptr) {
+      *slot.statusPtr = buffer[4];
+    }
+    if (slot.readDstPtr != nullptr) {
+      std::copy(buffer.cbegin(), buffer.cbegin() + 4, slot.readDstPtr);
+    }
+    break;
+  default:
+    break;
+  }
+
+  /* A command that cut into a gated block stream saw the latest JOYSTAT; spare the gate a poll */
+  if (m_blockIssued && xferStatus == GBA_READY) {
+    m_block.jstat = m_lastJStat;
+    m_block.jstatValid = true;
+  }
+
+  slot.statusPtr = nullptr;
+  slot.readDstPtr = nullptr;
+  if (slot.callback) {
+    FGBACallback cb = std::move(slot.callback);
+    slot.callback = {};
+    dispatchCallback(std::move(cb), xferStatus, joyBootStep);
+  }
+  publishProgress();
+}
+
+void Endpoint::finishBlock(EJoyReturn xferStatus) {
+  const size_t transferred = m_block.transferred;
+  CommandSlot& slot = laneSlot(EJoyLane::Bulk);
+  slot.issued = false;
+  ++slot.completions;
+  slot.joyBootStep = false;
+  m_blockIssued = false;
+
+  slot.statusPtr = nullptr;
+  m_block.src = nullptr;
+  m_block.dst = nullptr;
+  if (m_block.callback) {
+    FGBABlockCallback cb = std::move(m_block.callback);
+    m_block.callback = {};
+    dispatchBlockCallback(std::move(cb), xferStatus, transferred);
+  }
+  publishProgress();
+}
+
+void Endpoint::failPending() {
+  /* Callbacks see m_running cleared, so nothing they submit is left behind */
+  while (CommandSlot* slot = nextIssued()) {
+    if (slot == &laneSlot(EJoyLane::Bulk) && m_blockIssued) {
+      finishBlock(GBA_NOT_READY);
+    } else {
+      m_lastCmd = slot->buffer[0];
+      slot->buffer = {};
+      finishCommand(*slot, GBA_NOT_READY);
+    }
+  }
+}
+
+size_t Endpoint::ResponseSize(u8 cmd) {
+  switch (cmd) {
+  case CMD_STATUS:
+  case CMD_RESET:
+    return 3;
+  case CMD_READ:
+    return 5;
+  default:
+    return 1;
+  }
+}
+
+bool Endpoint::beginPolledCycle(u64 now) {
+  Buffer buffer{};
+  if (CommandSlot* slot = nextIssued()) {
+    if (slot == &laneSlot(EJoyLane::Bulk) && m_blockIssued) {
+      if (m_block.transferred >= m_block.length) {
+        finishBlock(GBA_READY);
+        return true;
+      }
+      m_pollCycle = buildBlockCycle(buffer) ? EPollCycle::BlockWord : EPollCycle::BlockGate;
+    } else {
+      buffer = slot->buffer;
+      m_pollCycle = EPollCycle::Command;
+      m_pollSlot = slot;
+    }
+  } else if ((!m_booted && now >= m_pollIdleTicks) || keepaliveDue(now)) {
+    /* Poll bus with status messages when inactive, and probe idle booted links */
+    if (m_booted)
+      ++m_health.keepalives;
+    buffer[0] = CMD_STATUS;
+    m_pollCycle = EPollCycle::Idle;
+  } else {
+    return false;
+  }
+
+  m_pollStartTicks = GetGCTicks();
+  clockSync();
+  send(buffer);
+  m_pollBuffer = buffer;
+  m_pollReceived = 0;
+  return true;
+}
+
+void Endpoint::completePolledCycle(u64 now) {
+  const EPollCycle cycle = m_pollCycle;
+  m_pollCycle = EPollCycle::None;
+  const u64 endTicks = GetGCTicks();
+  recordResponse(m_pollStartTicks, endTicks);
+  m_lastIoTicks = endTicks;
+
+  switch (cycle) {
+  case EPollCycle::Command:
+    m_pollSlot->buffer = m_pollBuffer;
+    finishCommand(*m_pollSlot, GBA_READY);
+    m_pollSlot = nullptr;
+    break;
+  case EPollCycle::BlockGate:
+  case EPollCycle::BlockWord:
+    if (completeBlockCycle(cycle == EPollCycle::BlockWord, m_pollBuffer))
+      finishBlock(GBA_READY);
+    break;
+  case EPollCycle::Idle:
+    m_lastJStat = m_pollBuffer[2];
+    publishStatus();
+    m_pollIdleTicks = now + GetGCTicksPerSec() * 4 / 60;
+    break;
+  default:
+    break;
+  }
+}
+
+bool Endpoint::closePolled() {
+  if (m_detached)
+    return false;
+  m_detached = true;
+
+  /* Operations cut short by a lost connection still complete, as on the transfer thread */
+  m_pollCycle = EPollCycle::None;
+  m_pollSlot = nullptr;
+  failPending();
+
+  publishStatus();
+  m_syncCv.notify_all();
+  if (m_stopRequested)
+    return false;
+  ++m_health.disconnects;
+  return true;
+}
+
+std::vector<net::Socket::SocketTp> Endpoint::pollFds() const {
+  std::unique_lock<std::mutex> lk(m_syncLock);
+  if (!m_polled || !m_running || !m_dataSocket)
+    return {};
+  return {m_dataSocket.GetInternalSocket()};
+}
+
+bool Endpoint::process(u64 now) {
+  if (!m_polled)
+    return m_running;
+
+  std::unique_lock<std::mutex> lk(m_syncLock);
+  while (m_running) {
+    const net::Socket* dataSocket = &m_dataSocket;
+    if (m_pollCycle == EPollCycle::None) {
+      /* Nothing was asked; readability here means the peer hung up */
+      if (net::Socket::WaitReadable(&dataSocket, 1, 0)) {
+        u8 discard[16];
+        size_t discarded;
+        if (m_dataSocket.recv(discard, sizeof(discard), discarded) == net::Socket::EResult::Error)
+          m_running = false;
+        continue;
+      }
+      if (!beginPolledCycle(now))
+        break;
+      continue;
+    }
+
+    if (!net::Socket::WaitReadable(&dataSocket, 1, 0)) {
+      if (m_responseTimeoutTicks && now > m_pollStartTicks && now - m_pollStartTicks >= m_responseTimeoutTicks) {
+        ++m_health.timeouts;
+        dropLink();
+      }
+      break;
+    }
+
+    /* Accumulate the response across as many reads as it arrives in */
+    const size_t expected = ResponseSize(m_pollBuffer[0]);
+    size_t received = 0;
+    const net::Socket::EResult result =
+        m_dataSocket.recv(m_pollBuffer.data() + m_pollReceived, expected - m_pollReceived, received);
+    if (result != net::Socket::EResult::OK) {
+      /* Busy: a LinkConditioner is still holding the bytes back */
+      if (result == net::Socket::EResult::Error)
+        m_running = false;
+      break;
+    }
+    m_pollReceived += received;
+    if (m_pollReceived >= expected)
+      completePolledCycle(now);
+  }
+
+  if (m_running)
+    return true;
+  if (closePolled() && m_disconnectCallback) {
+    FGBADisconnectCallback callback = m_disconnectCallback;
+    lk.unlock();
+    callback(*this);
+  }
+  return m_running;
+}
+
+u64 Endpoint::nextDeadline() {
+  std::unique_lock<std::mutex> lk(m_syncLock);
+  if (!m_polled || !m_running)
+    return ~u64(0);
+  if (m_pollCycle != EPollCycle::None) {
+    if (m_responseTimeoutTicks)
+      return std::min(m_dataSocket.nextDelivery(), m_pollStartTicks + m_responseTimeoutTicks);
+    return m_dataSocket.nextDelivery();
+  }
+  if (nextIssued())
+    return 0;
+  if (!m_booted)
+    return m_pollIdleTicks;
+  if (m_keepaliveTicks)
+    return m_lastIoTicks + m_keepaliveTicks;
+  return ~u64(0);
+}
+
 void Endpoint::transferWakeup(ThreadLocalEndpoint& endpoint, u8 status) { m_syncCv.notify_all(); }
 
+FGBAJoyBootCallback Endpoint::deferJoyBootCallback(FGBAJoyBootCallback&& callback) {
+  if (!m_executor || !callback)
+    return std::move(callback);
+
+  return [this, callback = std::move(callback)](ThreadLocalEndpoint&, const JoyBootResult& result) mutable {
+    m_executor->post(*m_strand, [this, callback = std::move(callback), result]() {
+      TraceSpan span("callback", getChan());
+      ThreadLocalEndpoint ep(*this, true);
+      JBUS_PROBE2(callback_start, getChan(), result.status);
+      callback(ep, result);
+      JBUS_PROBE2(callback_done, getChan(), result.status);
+    });
+  };
+}
+
+/* Plain completions of a JoyBoot only need the final status */
+static FGBAJoyBootCallback StatusOnly(FGBACallback&& callback) {
+  if (!callback)
+    return {};
+  return [callback = std::move(callback)](ThreadLocalEndpoint& endpoint, const JoyBootResult& result) {
+    callback(endpoint, result.status);
+  };
+}
+
+void Endpoint::dispatchCallback(FGBACallback&& callback, EJoyReturn status, bool joyBootStep) {
+  /* JoyBoot steps must chain on the transfer thread;
+   * its final user callback was already wrapped by deferJoyBootCallback */
+  if (!m_executor || joyBootStep) {
+    TraceSpan span("callback", getChan());
+    ThreadLocalEndpoint ep(*this, false, joyBootStep);
+    JBUS_PROBE2(callback_start, getChan(), status);
+    callback(ep, status);
+    JBUS_PROBE2(callback_done, getChan(), status);
+    return;
+  }
+
+  m_executor->post(*m_strand, [this, callback = std::move(callback), status]() {
+    TraceSpan span("callback", getChan());
+    ThreadLocalEndpoint ep(*this, true);
+    JBUS_PROBE2(callback_start, getChan(), status);
+    callback(ep, status);
+    JBUS_PROBE2(callback_done, getChan(), status);
+  });
+}
+
+void Endpoint::dispatchBlockCallback(FGBABlockCallback&& callback, EJoyReturn status, size_t transferred) {
+  if (!m_executor) {
+    TraceSpan span("callback", getChan());
+    ThreadLocalEndpoint ep(*this);
+    JBUS_PROBE2(callback_start, getChan(), status);
+    callback(ep, status, transferred);
+    JBUS_PROBE2(callback_done, getChan(), status);
+    return;
+  }
+
+  m_executor->post(*m_strand, [this, callback = std::move(callback), status, transferred]() {
+    TraceSpan span("callback", getChan());
+    ThreadLocalEndpoint ep(*this, true);
+    JBUS_PROBE2(callback_start, getChan(), status);
+    callback(ep, status, transferred);
+    JBUS_PROBE2(callback_done, getChan(), status);
+  });
+}
+
+void Endpoint::StopAll(std::span<Endpoint* const> endpoints) {
+  /* Wake every transfer thread first so the joins overlap */
+  for (Endpoint* endpoint : endpoints)
+    if (endpoint)
+      endpoint->requestStop();
+  for (Endpoint* endpoint : endpoints)
+    if (endpoint)
+      endpoint->stop();
+}
+
+void Endpoint::StopAll(std::span<const std::unique_ptr<Endpoint>> endpoints) {
+  for (const auto& endpoint : endpoints)
+    if (endpoint)
+      endpoint->requestStop();
+  for (const auto& endpoint : endpoints)
+    if (endpoint)
+      endpoint->stop();
+}
+
+void Endpoint::setCompletionExecutor(CompletionExecutor* executor) {
+  /* Pending callbacks may submit through the locking interface; drain before locking */
+  if (m_strand)
+    m_executor->drain(*m_strand);
+
+  std::unique_lock<std::mutex> lk(m_syncLock);
+  m_executor = executor;
+  m_strand = executor ? executor->makeStrand() : nullptr;
+}
+
+void Endpoint::requestStop() {
+  /* Raised first so the transfer thread never mistakes the stop for a lost link */
+  m_stopRequested = true;
+
+  /* Break the transfer thread out of blocking socket I/O */
+  dropLink();
+
+  /* Cycling the lock orders the flags before a waiter's predicate check, so the notify
+   * cannot be lost; the transfer thread itself re-checks m_running without it */
+  if (!m_polled && !m_transferThread.isCurrent()) {
+    std::unique_lock<std::mutex> lk(m_syncLock);
+    lk.unlock();
+    m_issueCv.notify_one();
+  }
+}
+
 void Endpoint::stop() {
-  m_running = false;
-  m_issueCv.notify_one();
+  requestStop();
   if (m_transferThread.joinable())
     m_transferThread.join();
+  {
+    /* A host thread may still be inside process(); it holds m_syncLock while using the sockets */
+    std::unique_lock<std::mutex> lk(m_syncLock);
+    if (m_polled)
+      closePolled();
+    std::unique_lock<std::mutex> socketLk(m_socketLock);
+    m_dataSocket.close();
+    m_clockSocket.close();
+  }
+  if (m_strand)
+    m_executor->drain(*m_strand);
 }
 
-EJoyReturn Endpoint::GBAGetProcessStatus(u8& percentOut) {
-  if (!m_running)
-    return GBA_NOT_READY;
+LinkHealth Endpoint::getHealth() {
+  std::unique_lock<std::mutex> lk(m_syncLock);
+  LinkHealth health = m_health;
+  health.connected = m_running;
+  return health;
+}
+
+net::IPAddress Endpoint::getPeerAddress() const {
+  /* reattach() may replace it from the listener thread */
+  std::unique_lock<std::mutex> lk(m_syncLock);
+  return m_peerAddress;
+}
+
+net::SocketOptions Endpoint::querySocketOptions() const {
+  std::unique_lock<std::mutex> lk(m_socketLock);
+  return m_dataSocket.queryOptions();
+}
+
+void Endpoint::setDisconnectCallback(FGBADisconnectCallback&& callback) {
+  std::unique_lock<std::mutex> lk(m_syncLock);
+  m_disconnectCallback = std::move(callback);
+}
 
+bool Endpoint::reattach(net::Socket&& data, net::Socket&& clock, const net::IPAddress& peerAddress) {
   std::unique_lock<std::mutex> lk(m_syncLock);
-  if (m_joyBoot) {
-    percentOut = m_joyBoot.percentComplete();
-    if (!m_joyBoot.isDone())
-      return GBA_BUSY;
+  if (m_stopRequested || m_running)
+    return false;
+
+  /* The link may have just dropped; let pending work fail against the old sockets first */
+  if (m_polled)
+    closePolled();
+  else
+    m_syncCv.wait(lk, [this]() { return m_detached || m_stopRequested.load(); });
+  if (m_stopRequested)
+    return false;
+
+  {
+    std::unique_lock<std::mutex> socketLk(m_socketLock);
+    m_dataSocket = std::move(data);
+    m_clockSocket = std::move(clock);
+    configureSockets();
   }
+  m_peerAddress = peerAddress;
+
+  /* A restarted emulator's GBA starts over in its BIOS */
+  m_booted = false;
+  m_lastGCTick = 0;
+  m_lastJStat = 0;
+  m_pollCycle = EPollCycle::None;
+  m_pollIdleTicks = 0;
+  m_lastIoTicks = GetGCTicks();
+  ++m_health.reattaches;
+  m_detached = false;
+  m_running = true;
+  publishStatus();
 
-  if (m_cmdIssued)
-    return GBA_BUSY;
+  m_issueCv.notify_one();
+  return true;
+}
 
-  return GBA_READY;
+ProcessStatus Endpoint::currentStatus() const {
+  ProcessStatus ret;
+  ret.lastJStat = m_lastJStat;
+  ret.joyBootStarted = bool(m_joyBoot);
+  if (m_joyBoot)
+    ret.percent = m_joyBoot.percentComplete();
+
+  if (m_joyBoot && !m_joyBoot.isDone()) {
+    ret.phase = m_joyBoot.phase();
+    ret.busy = true;
+    ret.bytesSent = m_joyBoot.bytesSent();
+    ret.totalBytes = m_joyBoot.totalBytes();
+  } else if (m_blockIssued) {
+    ret.phase = ProcessStatus::EPhase::Block;
+    ret.busy = true;
+    ret.bytesSent = u32(m_block.transferred);
+    ret.totalBytes = u32(m_block.length);
+  } else if (std::any_of(m_lanes.cbegin(), m_lanes.cend(), [](const CommandSlot& slot) { return slot.issued; })) {
+    ret.phase = ProcessStatus::EPhase::Command;
+    ret.busy = true;
+  }
+
+  return ret;
 }
 
-EJoyReturn Endpoint::GBAGetStatusAsync(u8* status, FGBACallback&& callback) {
+ProcessStatus Endpoint::publishStatus() {
+  const ProcessStatus status = currentStatus();
+
+  /* Writers are serialized by m_syncLock; an odd sequence marks an update in progress */
+  const u32 seq = m_published.seq.load(std::memory_order_relaxed);
+  m_published.seq.store(seq + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  m_published.phase.store(status.phase, std::memory_order_relaxed);
+  m_published.busy.store(status.busy, std::memory_order_relaxed);
+  m_published.joyBootStarted.store(status.joyBootStarted, std::memory_order_relaxed);
+  m_published.bytesSent.store(status.bytesSent, std::memory_order_relaxed);
+  m_published.totalBytes.store(status.totalBytes, std::memory_order_relaxed);
+  m_published.lastJStat.store(status.lastJStat, std::memory_order_relaxed);
+  m_published.percent.store(status.percent, std::memory_order_relaxed);
+  m_published.seq.store(seq + 2, std::memory_order_release);
+  return status;
+}
+
+void Endpoint::publishProgress() {
+  const ProcessStatus status = publishStatus();
+  if (!m_progressCallback)
+    return;
+
+  if (status.phase == m_progressPhase) {
+    if (status.bytesSent == m_progressBytes ||
+        (status.bytesSent > m_progressBytes && status.bytesSent - m_progressBytes < m_progressGranularity &&
+         status.bytesSent != status.totalBytes))
+      return;
+  }
+
+  m_progressPhase = status.phase;
+  m_progressBytes = status.bytesSent;
+  m_progressCallback(status);
+}
+
+void Endpoint::setProgressCallback(FGBAProgressCallback&& callback, u32 granularity) {
+  std::unique_lock<std::mutex> lk(m_syncLock);
+  m_progressCallback = std::move(callback);
+  m_progressGranularity = granularity;
+  m_progressBytes = 0;
+  m_progressPhase = ProcessStatus::EPhase::Idle;
+}
+
+EJoyReturn Endpoint::GBAGetProcessStatus(ProcessStatus& statusOut) {
+  u32 seq;
+  do {
+    seq = m_published.seq.load(std::memory_order_acquire);
+    statusOut.phase = m_published.phase.load(std::memory_order_relaxed);
+    statusOut.busy = m_published.busy.load(std::memory_order_relaxed);
+    statusOut.joyBootStarted = m_published.joyBootStarted.load(std::memory_order_relaxed);
+    statusOut.bytesSent = m_published.bytesSent.load(std::memory_order_relaxed);
+    statusOut.totalBytes = m_published.totalBytes.load(std::memory_order_relaxed);
+    statusOut.lastJStat = m_published.lastJStat.load(std::memory_order_relaxed);
+    statusOut.percent = m_published.percent.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+  } while ((seq & 1) || seq != m_published.seq.load(std::memory_order_relaxed));
+
+  if (!m_running)
+    return GBA_NOT_READY;
+
+  return statusOut.busy ? GBA_BUSY : GBA_READY;
+}
+
+EJoyReturn Endpoint::GBAGetProcessStatus(u8& percentOut) {
+  if (!m_running)
+    return GBA_NOT_READY;
+
+  ProcessStatus status;
+  EJoyReturn ret = GBAGetProcessStatus(status);
+  if (status.joyBootStarted)
+    percentOut = status.percent;
+
+  return ret;
+}
+
+EJoyReturn Endpoint::GBAGetStatusAsync(u8* status, FGBACallback&& callback, EJoyLane lane) {
   if (!m_running)
     return GBA_NOT_READY;
 
   std::unique_lock<std::mutex> lk(m_syncLock);
-  if (m_cmdIssued)
+  CommandSlot& slot = laneSlot(lane);
+  if (!canIssue(slot))
     return GBA_NOT_READY;
 
-  m_cmdIssued = true;
-  m_statusPtr = status;
-  m_buffer[0] = CMD_STATUS;
-  m_callback = std::move(callback);
+  slot.issued = true;
+  slot.statusPtr = status;
+  slot.buffer[0] = CMD_STATUS;
+  JBUS_PROBE2(cmd_submit, getChan(), CMD_STATUS);
+  slot.callback = std::move(callback);
+  publishStatus();
 
   m_issueCv.notify_one();
 
   return GBA_READY;
 }
 
-EJoyReturn Endpoint::GBAGetStatus(u8* status) {
+EJoyReturn Endpoint::GBAGetStatus(u8* status, EJoyLane lane) {
   if (!m_running)
     return GBA_NOT_READY;
 
   std::unique_lock<std::mutex> lk(m_syncLock);
-  if (m_cmdIssued)
+  CommandSlot& slot = laneSlot(lane);
+  if (!canIssue(slot))
     return GBA_NOT_READY;
 
-  m_cmdIssued = true;
-  m_statusPtr = status;
-  m_buffer[0] = CMD_STATUS;
-  m_callback = bindSync();
+  const u32 completions = slot.completions;
+  slot.issued = true;
+  slot.statusPtr = status;
+  slot.buffer[0] = CMD_STATUS;
+  JBUS_PROBE2(cmd_submit, getChan(), CMD_STATUS);
+  slot.callback = bindSync();
+  publishStatus();
 
   m_issueCv.notify_one();
-  m_syncCv.wait(lk);
+  m_syncCv.wait(lk, [&]() { return slot.completions != completions; });
 
   return GBA_READY;
 }
 
-EJoyReturn Endpoint::GBAResetAsync(u8* status, FGBACallback&& callback) {
+EJoyReturn Endpoint::GBAResetAsync(u8* status, FGBACallback&& callback, EJoyLane lane) {
   if (!m_running)
     return GBA_NOT_READY;
 
   std::unique_lock<std::mutex> lk(m_syncLock);
-  if (m_cmdIssued)
+  CommandSlot& slot = laneSlot(lane);
+  if (!canIssue(slot))
     return GBA_NOT_READY;
 
-  m_cmdIssued = true;
-  m_statusPtr = status;
-  m_buffer[0] = CMD_RESET;
-  m_callback = std::move(callback);
+  slot.issued = true;
+  slot.statusPtr = status;
+  slot.buffer[0] = CMD_RESET;
+  JBUS_PROBE2(cmd_submit, getChan(), CMD_RESET);
+  slot.callback = std::move(callback);
+  publishStatus();
 
   m_issueCv.notify_one();
 
   return GBA_READY;
 }
 
-EJoyReturn Endpoint::GBAReset(u8* status) {
+EJoyReturn Endpoint::GBAReset(u8* status, EJoyLane lane) {
   if (!m_running)
     return GBA_NOT_READY;
 
   std::unique_lock<std::mutex> lk(m_syncLock);
-  if (m_cmdIssued)
+  CommandSlot& slot = laneSlot(lane);
+  if (!canIssue(slot))
     return GBA_NOT_READY;
 
-  m_cmdIssued = true;
-  m_statusPtr = status;
-  m_buffer[0] = CMD_RESET;
-  m_callback = bindSync();
+  const u32 completions = slot.completions;
+  slot.issued = true;
+  slot.statusPtr = status;
+  slot.buffer[0] = CMD_RESET;
+  JBUS_PROBE2(cmd_submit, getChan(), CMD_RESET);
+  slot.callback = bindSync();
+  publishStatus();
 
   m_issueCv.notify_one();
-  m_syncCv.wait(lk);
+  m_syncCv.wait(lk, [&]() { return slot.completions != completions; });
 
   return GBA_READY;
 }
 
-EJoyReturn Endpoint::GBAReadAsync(ReadWriteBuffer& dst, u8* status, FGBACallback&& callback) {
+EJoyReturn Endpoint::GBAReadAsync(ReadWriteBuffer& dst, u8* status, FGBACallback&& callback, EJoyLane lane) {
   if (!m_running) {
     return GBA_NOT_READY;
   }
 
   std::unique_lock<std::mutex> lk(m_syncLock);
-  if (m_cmdIssued) {
+  CommandSlot& slot = laneSlot(lane);
+  if (!canIssue(slot)) {
     return GBA_NOT_READY;
   }
 
-  m_cmdIssued = true;
-  m_statusPtr = status;
-  m_readDstPtr = dst.data();
-  m_buffer[0] = CMD_READ;
-  m_callback = std::move(callback);
+  slot.issued = true;
+  slot.statusPtr = status;
+  slot.readDstPtr = dst.data();
+  slot.buffer[0] = CMD_READ;
+  JBUS_PROBE2(cmd_submit, getChan(), CMD_READ);
+  slot.callback = std::move(callback);
+  publishStatus();
 
   m_issueCv.notify_one();
 
   return GBA_READY;
 }
 
-EJoyReturn Endpoint::GBARead(ReadWriteBuffer& dst, u8* status) {
+EJoyReturn Endpoint::GBARead(ReadWriteBuffer& dst, u8* status, EJoyLane lane) {
   if (!m_running) {
     return GBA_NOT_READY;
   }
 
   std::unique_lock<std::mutex> lk(m_syncLock);
-  if (m_cmdIssued) {
+  CommandSlot& slot = laneSlot(lane);
+  if (!canIssue(slot)) {
     return GBA_NOT_READY;
   }
 
-  m_cmdIssued = true;
-  m_statusPtr = status;
-  m_readDstPtr = dst.data();
-  m_buffer[0] = CMD_READ;
-  m_callback = bindSync();
+  const u32 completions = slot.completions;
+  slot.issued = true;
+  slot.statusPtr = status;
+  slot.readDstPtr = dst.data();
+  slot.buffer[0] = CMD_READ;
+  JBUS_PROBE2(cmd_submit, getChan(), CMD_READ);
+  slot.callback = bindSync();
+  publishStatus();
 
   m_issueCv.notify_one();
-  m_syncCv.wait(lk);
+  m_syncCv.wait(lk, [&]() { return slot.completions != completions; });
 
   return GBA_READY;
 }
 
-EJoyReturn Endpoint::GBAWriteAsync(ReadWriteBuffer src, u8* status, FGBACallback&& callback) {
+EJoyReturn Endpoint::GBAWriteAsync(ReadWriteBuffer src, u8* status, FGBACallback&& callback, EJoyLane lane) {
   if (!m_running) {
     return GBA_NOT_READY;
   }
 
   std::unique_lock<std::mutex> lk(m_syncLock);
-  if (m_cmdIssued) {
+  CommandSlot& slot = laneSlot(lane);
+  if (!canIssue(slot)) {
     return GBA_NOT_READY;
   }
 
-  m_cmdIssued = true;
-  m_statusPtr = status;
-  m_buffer[0] = CMD_WRITE;
+  slot.issued = true;
+  slot.statusPtr = status;
+  slot.buffer[0] = CMD_WRITE;
+  JBUS_PROBE2(cmd_submit, getChan(), CMD_WRITE);
   for (size_t i = 0; i < src.size(); ++i) {
-    m_buffer[i + 1] = src[i];
+    slot.buffer[i + 1] = src[i];
   }
-  m_callback = std::move(callback);
+  slot.callback = std::move(callback);
+  publishStatus();
 
   m_issueCv.notify_one();
 
   return GBA_READY;
 }
 
-EJoyReturn Endpoint::GBAWrite(ReadWriteBuffer src, u8* status) {
+EJoyReturn Endpoint::GBAWrite(ReadWriteBuffer src, u8* status, EJoyLane lane) {
   if (!m_running) {
     return GBA_NOT_READY;
   }
 
   std::unique_lock<std::mutex> lk(m_syncLock);
-  if (m_cmdIssued) {
+  CommandSlot& slot = laneSlot(lane);
+  if (!canIssue(slot)) {
     return GBA_NOT_READY;
   }
 
-  m_cmdIssued = true;
-  m_statusPtr = status;
-  m_buffer[0] = CMD_WRITE;
+  const u32 completions = slot.completions;
+  slot.issued = true;
+  slot.statusPtr = status;
+  slot.buffer[0] = CMD_WRITE;
+  JBUS_PROBE2(cmd_submit, getChan(), CMD_WRITE);
   for (size_t i = 0; i < src.size(); ++i) {
-    m_buffer[i + 1] = src[i];
+    slot.buffer[i + 1] = src[i];
   }
-  m_callback = bindSync();
+  slot.callback = bindSync();
+  publishStatus();
 
   m_issueCv.notify_one();
-  m_syncCv.wait(lk);
+  m_syncCv.wait(lk, [&]() { return slot.completions != completions; });
 
   return GBA_READY;
 }
 
-EJoyReturn Endpoint::GBAJoyBootAsync(s32 paletteColor, s32 paletteSpeed, const u8* programp, s32 length, u8* status,
-                                     FGBACallback&& callback) {
-  if (!m_running)
+EJoyReturn Endpoint::GBAWriteBlockAsync(std::span<const u8> src, u8* status, FGBABlockCallback&& callback,
+                                        bool gate) {
+  if (!m_running) {
     return GBA_NOT_READY;
+  }
 
-  if (m_chan > 3)
-    return GBA_JOYBOOT_ERR_INVALID;
+  std::unique_lock<std::mutex> lk(m_syncLock);
+  CommandSlot& slot = laneSlot(EJoyLane::Bulk);
+  if (!canIssue(slot)) {
+    return GBA_NOT_READY;
+  }
 
+  slot.issued = true;
+  m_blockIssued = true;
+  JBUS_PROBE2(cmd_submit, getChan(), CMD_WRITE);
+  slot.statusPtr = status;
+  m_block = {nullptr, src.data(), src.size(), 0, gate, std::move(callback)};
+  publishStatus();
+
+  m_issueCv.notify_one();
+
+  return GBA_READY;
+}
+
+EJoyReturn Endpoint::GBAReadBlockAsync(std::span<u8> dst, u8* status, FGBABlockCallback&& callback, bool gate) {
+  if (!m_running) {
+    return GBA_NOT_READY;
+  }
+
+  std::unique_lock<std::mutex> lk(m_syncLock);
+  CommandSlot& slot = laneSlot(EJoyLane::Bulk);
+  if (!canIssue(slot)) {
+    return GBA_NOT_READY;
+  }
+
+  slot.issued = true;
+  m_blockIssued = true;
+  JBUS_PROBE2(cmd_submit, getChan(), CMD_READ);
+  slot.statusPtr = status;
+  m_block = {dst.data(), nullptr, dst.size(), 0, gate, std::move(callback)};
+  publishStatus();
+
+  m_issueCv.notify_one();
+
+  return GBA_READY;
+}
+
+EJoyReturn Endpoint::ValidateJoyBoot(s32 paletteColor, s32 paletteSpeed, const u8* programp, s32 length) {
   if (!length || length >= 0x40000)
     return GBA_JOYBOOT_ERR_INVALID;
 
@@ -714,69 +1448,210 @@ EJoyReturn Endpoint::GBAJoyBootAsync(s32 paletteColor, s32 paletteSpeed, const u
   if (programp[0xac] * programp[0xac] * programp[0xac] * programp[0xac] == 0)
     return GBA_JOYBOOT_ERR_INVALID;
 
-  m_joyBoot = KawasedoChallenge(paletteColor, paletteSpeed, programp, length, status, std::move(callback));
-  m_joyBoot.start(*this);
+  return GBA_READY;
+}
+
+EJoyReturn Endpoint::GBAJoyBootAsync(s32 paletteColor, s32 paletteSpeed, const u8* programp, s32 length, u8* status,
+                                     FGBACallback&& callback) {
+  return GBAJoyBootAsync(paletteColor, paletteSpeed, programp, length, status, StatusOnly(std::move(callback)));
+}
+
+EJoyReturn Endpoint::GBAJoyBootAsync(s32 paletteColor, s32 paletteSpeed, const u8* programp, s32 length, u8* status,
+                                     FGBAJoyBootCallback&& callback) {
+  if (!m_running)
+    return GBA_NOT_READY;
+
+  if (m_chan > 3)
+    return GBA_JOYBOOT_ERR_INVALID;
+
+  if (EJoyReturn ret = ValidateJoyBoot(paletteColor, paletteSpeed, programp, length); ret != GBA_READY)
+    return ret;
+
+  std::unique_lock<std::mutex> lk(m_syncLock);
+  if (!canStartJoyBoot())
+    return GBA_NOT_READY;
+
+  m_joyBoot = KawasedoChallenge(paletteColor, paletteSpeed, programp, length, status,
+                                deferJoyBootCallback(std::move(callback)));
+  ThreadLocalEndpoint ep(*this, false, true);
+  m_joyBoot.start(ep);
   if (!m_joyBoot.started())
     return GBA_NOT_READY;
+  publishStatus();
+
+  m_issueCv.notify_one();
 
   return GBA_READY;
 }
 
-Endpoint::Endpoint(u8 chan, net::Socket&& data, net::Socket&& clock)
-: m_dataSocket(std::move(data)), m_clockSocket(std::move(clock)), m_chan(chan) {
-  m_transferThread = std::thread(std::bind(&Endpoint::transferProc, this));
+Endpoint::Endpoint(u8 chan, net::Socket&& data, net::Socket&& clock, const net::IPAddress& peerAddress,
+                   const EndpointOptions& options)
+: m_dataSocket(std::move(data))
+, m_clockSocket(std::move(clock))
+, m_peerAddress(peerAddress)
+, m_chan(chan)
+, m_polled(options.polled)
+, m_socketOptions(options.socketOptions)
+, m_conditionerOptions(options.linkConditioner)
+, m_keepaliveTicks(options.keepaliveTicks)
+, m_responseTimeoutTicks(options.responseTimeoutTicks)
+, m_lastIoTicks(GetGCTicks()) {
+  configureSockets();
+  if (!m_polled)
+    if (!m_transferThread.start(options.transferThread, std::bind(&Endpoint::transferProc, this))) {
+      /* Without a thread to resume there is nothing to reattach */
+      m_stopRequested = true;
+      m_running = false;
+    }
 }
 
 Endpoint::~Endpoint() { stop(); }
 
-EJoyReturn ThreadLocalEndpoint::GBAGetStatusAsync(u8* status, FGBACallback&& callback) {
-  if (!m_ep.m_running || m_ep.m_cmdIssued)
+std::unique_ptr<Endpoint> Endpoint::Adopt(u8 chan, net::Socket::SocketTp dataSocket, net::Socket::SocketTp clockSocket,
+                                          const net::IPAddress& peerAddress, const EndpointOptions& options) {
+  return std::make_unique<Endpoint>(chan, net::Socket::Adopt(dataSocket, true), net::Socket::Adopt(clockSocket, true),
+                                    peerAddress, options);
+}
+
+EJoyReturn ThreadLocalEndpoint::GBAGetStatusAsync(u8* status, FGBACallback&& callback, EJoyLane lane) {
+  if (m_deferred)
+    return m_ep.GBAGetStatusAsync(status, std::move(callback), lane);
+
+  Endpoint::CommandSlot& slot = m_ep.laneSlot(lane);
+  if (!m_ep.canIssue(slot, m_joyBootStep))
     return GBA_NOT_READY;
 
-  m_ep.m_cmdIssued = true;
-  m_ep.m_statusPtr = status;
-  m_ep.m_buffer[0] = Endpoint::CMD_STATUS;
-  m_ep.m_callback = std::move(callback);
+  slot.issued = true;
+  slot.joyBootStep = m_joyBootStep;
+  slot.statusPtr = status;
+  slot.buffer[0] = Endpoint::CMD_STATUS;
+  JBUS_PROBE2(cmd_submit, getChan(), Endpoint::CMD_STATUS);
+  slot.callback = std::move(callback);
 
   return GBA_READY;
 }
 
-EJoyReturn ThreadLocalEndpoint::GBAResetAsync(u8* status, FGBACallback&& callback) {
-  if (!m_ep.m_running || m_ep.m_cmdIssued)
+EJoyReturn ThreadLocalEndpoint::GBAResetAsync(u8* status, FGBACallback&& callback, EJoyLane lane) {
+  if (m_deferred)
+    return m_ep.GBAResetAsync(status, std::move(callback), lane);
+
+  Endpoint::CommandSlot& slot = m_ep.laneSlot(lane);
+  if (!m_ep.canIssue(slot, m_joyBootStep))
     return GBA_NOT_READY;
 
-  m_ep.m_cmdIssued = true;
-  m_ep.m_statusPtr = status;
-  m_ep.m_buffer[0] = Endpoint::CMD_RESET;
-  m_ep.m_callback = std::move(callback);
+  slot.issued = true;
+  slot.joyBootStep = m_joyBootStep;
+  slot.statusPtr = status;
+  slot.buffer[0] = Endpoint::CMD_RESET;
+  JBUS_PROBE2(cmd_submit, getChan(), Endpoint::CMD_RESET);
+  slot.callback = std::move(callback);
 
   return GBA_READY;
 }
 
-EJoyReturn ThreadLocalEndpoint::GBAReadAsync(ReadWriteBuffer& dst, u8* status, FGBACallback&& callback) {
-  if (!m_ep.m_running || m_ep.m_cmdIssued)
+EJoyReturn ThreadLocalEndpoint::GBAReadAsync(ReadWriteBuffer& dst, u8* status, FGBACallback&& callback, EJoyLane lane) {
+  if (m_deferred)
+    return m_ep.GBAReadAsync(dst, status, std::move(callback), lane);
+
+  Endpoint::CommandSlot& slot = m_ep.laneSlot(lane);
+  if (!m_ep.canIssue(slot, m_joyBootStep))
     return GBA_NOT_READY;
 
-  m_ep.m_cmdIssued = true;
-  m_ep.m_statusPtr = status;
-  m_ep.m_readDstPtr = dst.data();
-  m_ep.m_buffer[0] = Endpoint::CMD_READ;
-  m_ep.m_callback = std::move(callback);
+  slot.issued = true;
+  slot.joyBootStep = m_joyBootStep;
+  slot.statusPtr = status;
+  slot.readDstPtr = dst.data();
+  slot.buffer[0] = Endpoint::CMD_READ;
+  JBUS_PROBE2(cmd_submit, getChan(), Endpoint::CMD_READ);
+  slot.callback = std::move(callback);
 
   return GBA_READY;
 }
 
-EJoyReturn ThreadLocalEndpoint::GBAWriteAsync(ReadWriteBuffer src, u8* status, FGBACallback&& callback) {
-  if (!m_ep.m_running || m_ep.m_cmdIssued)
+EJoyReturn ThreadLocalEndpoint::GBAWriteAsync(ReadWriteBuffer src, u8* status, FGBACallback&& callback, EJoyLane lane) {
+  if (m_deferred)
+    return m_ep.GBAWriteAsync(src, status, std::move(callback), lane);
+
+  Endpoint::CommandSlot& slot = m_ep.laneSlot(lane);
+  if (!m_ep.canIssue(slot, m_joyBootStep))
     return GBA_NOT_READY;
 
-  m_ep.m_cmdIssued = true;
-  m_ep.m_statusPtr = status;
-  m_ep.m_buffer[0] = Endpoint::CMD_WRITE;
+  slot.issued = true;
+  slot.joyBootStep = m_joyBootStep;
+  slot.statusPtr = status;
+  slot.buffer[0] = Endpoint::CMD_WRITE;
+  JBUS_PROBE2(cmd_submit, getChan(), Endpoint::CMD_WRITE);
   for (size_t i = 0; i < src.size(); ++i) {
-    m_ep.m_buffer[i + 1] = src[i];
+    slot.buffer[i + 1] = src[i];
   }
-  m_ep.m_callback = std::move(callback);
+  slot.callback = std::move(callback);
+
+  return GBA_READY;
+}
+
+EJoyReturn ThreadLocalEndpoint::GBAWriteBlockAsync(std::span<const u8> src, u8* status, FGBABlockCallback&& callback,
+                                                   bool gate) {
+  if (m_deferred)
+    return m_ep.GBAWriteBlockAsync(src, status, std::move(callback), gate);
+
+  Endpoint::CommandSlot& slot = m_ep.laneSlot(EJoyLane::Bulk);
+  if (!m_ep.canIssue(slot, m_joyBootStep))
+    return GBA_NOT_READY;
+
+  slot.issued = true;
+  slot.joyBootStep = m_joyBootStep;
+  m_ep.m_blockIssued = true;
+  JBUS_PROBE2(cmd_submit, getChan(), Endpoint::CMD_WRITE);
+  slot.statusPtr = status;
+  m_ep.m_block = {nullptr, src.data(), src.size(), 0, gate, std::move(callback)};
+
+  return GBA_READY;
+}
+
+EJoyReturn ThreadLocalEndpoint::GBAReadBlockAsync(std::span<u8> dst, u8* status, FGBABlockCallback&& callback,
+                                                  bool gate) {
+  if (m_deferred)
+    return m_ep.GBAReadBlockAsync(dst, status, std::move(callback), gate);
+
+  Endpoint::CommandSlot& slot = m_ep.laneSlot(EJoyLane::Bulk);
+  if (!m_ep.canIssue(slot, m_joyBootStep))
+    return GBA_NOT_READY;
+
+  slot.issued = true;
+  slot.joyBootStep = m_joyBootStep;
+  m_ep.m_blockIssued = true;
+  JBUS_PROBE2(cmd_submit, getChan(), Endpoint::CMD_READ);
+  slot.statusPtr = status;
+  m_ep.m_block = {dst.data(), nullptr, dst.size(), 0, gate, std::move(callback)};
+
+  return GBA_READY;
+}
+
+EJoyReturn ThreadLocalEndpoint::GBAJoyBootAsync(s32 paletteColor, s32 paletteSpeed, const u8* programp, s32 length,
+                                                u8* status, FGBACallback&& callback) {
+  return GBAJoyBootAsync(paletteColor, paletteSpeed, programp, length, status, StatusOnly(std::move(callback)));
+}
+
+EJoyReturn ThreadLocalEndpoint::GBAJoyBootAsync(s32 paletteColor, s32 paletteSpeed, const u8* programp, s32 length,
+                                                u8* status, FGBAJoyBootCallback&& callback) {
+  if (m_deferred)
+    return m_ep.GBAJoyBootAsync(paletteColor, paletteSpeed, programp, length, status, std::move(callback));
+
+  if (!m_ep.canStartJoyBoot())
+    return GBA_NOT_READY;
+
+  if (m_ep.m_chan > 3)
+    return GBA_JOYBOOT_ERR_INVALID;
+
+  if (EJoyReturn ret = Endpoint::ValidateJoyBoot(paletteColor, paletteSpeed, programp, length); ret != GBA_READY)
+    return ret;
+
+  m_ep.m_joyBoot = Endpoint::KawasedoChallenge(paletteColor, paletteSpeed, programp, length, status,
+                                               m_ep.deferJoyBootCallback(std::move(callback)));
+  ThreadLocalEndpoint ep(m_ep, false, true);
+  m_ep.m_joyBoot.start(ep);
+  if (!m_ep.m_joyBoot.started())
+    return GBA_NOT_READY;
 
   return GBA_READY;
 }
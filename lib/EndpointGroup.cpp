@@ -0,0 +1,144 @@
+#include "jbus/EndpointGroup.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "jbus/Endpoint.hpp"
+
+namespace jbus {
+
+/** State shared by every member of one broadcast; freed with the last member callback. */
+struct EndpointGroup::Broadcast {
+  std::vector<u8> payload;
+  GroupResult result;
+  FGBAGroupCallback callback;
+  std::atomic<size_t> remaining{0};
+
+  void complete() {
+    /* Member results are published by the release half of the last decrement */
+    if (remaining.fetch_sub(1, std::memory_order_acq_rel) != 1)
+      return;
+
+    result.status = GBA_READY;
+    for (size_t i = 0; i < result.count; ++i)
+      if (result.members[i].status != GBA_READY)
+        result.status = GBA_NOT_READY;
+    if (callback)
+      callback(result);
+  }
+};
+
+bool EndpointGroup::addEndpoint(Endpoint& endpoint) {
+  if (m_count == m_members.size() || std::find(m_members.begin(), m_members.begin() + m_count, &endpoint) !=
+                                         m_members.begin() + m_count)
+    return false;
+
+  m_members[m_count++] = &endpoint;
+  return true;
+}
+
+bool EndpointGroup::removeEndpoint(Endpoint& endpoint) {
+  auto it = std::find(m_members.begin(), m_members.begin() + m_count, &endpoint);
+  if (it == m_members.begin() + m_count)
+    return false;
+
+  std::move(it + 1, m_members.begin() + m_count, it);
+  m_members[--m_count] = nullptr;
+  return true;
+}
+
+template <typename Submit>
+EJoyReturn EndpointGroup::broadcast(FGBAGroupCallback&& callback, std::span<const u8> payload, Submit&& submit) {
+  if (!m_count)
+    return GBA_NOT_READY;
+
+  auto state = std::make_shared<Broadcast>();
+  state->payload.assign(payload.begin(), payload.end());
+  state->result.count = m_count;
+  state->callback = std::move(callback);
+  /* The extra count holds completion back until every member has been submitted to */
+  state->remaining.store(m_count + 1, std::memory_order_relaxed);
+
+  size_t accepted = 0;
+  bool anyPolled = false;
+  for (size_t i = 0; i < m_count; ++i) {
+    GroupResult::Member& member = state->result.members[i];
+    member.endpoint = m_members[i];
+    member.submitted = submit(*m_members[i], state, member) == GBA_READY;
+    if (member.submitted) {
+      ++accepted;
+      anyPolled |= m_members[i]->isPolled();
+    } else {
+      state->remaining.fetch_sub(1, std::memory_order_relaxed);
+    }
+  }
+
+  if (!accepted)
+    return GBA_NOT_READY;
+
+  /* Polled members would otherwise send on the host's next pass, one wakeup apart */
+  if (anyPolled) {
+    const u64 now = GetGCTicks();
+    for (size_t i = 0; i < m_count; ++i)
+      if (state->result.members[i].submitted && m_members[i]->isPolled())
+        m_members[i]->process(now);
+  }
+
+  state->complete();
+  return GBA_READY;
+}
+
+EJoyReturn EndpointGroup::GBAGetStatusAsync(FGBAGroupCallback&& callback, EJoyLane lane) {
+  return broadcast(std::move(callback), {}, [lane](Endpoint& endpoint, const auto& state, GroupResult::Member& member) {
+    return endpoint.GBAGetStatusAsync(
+        &member.jstat,
+        [state, &member](ThreadLocalEndpoint&, EJoyReturn status) {
+          member.status = status;
+          state->complete();
+        },
+        lane);
+  });
+}
+
+EJoyReturn EndpointGroup::GBAResetAsync(FGBAGroupCallback&& callback, EJoyLane lane) {
+  return broadcast(std::move(callback), {}, [lane](Endpoint& endpoint, const auto& state, GroupResult::Member& member) {
+    return endpoint.GBAResetAsync(
+        &member.jstat,
+        [state, &member](ThreadLocalEndpoint&, EJoyReturn status) {
+          member.status = status;
+          state->complete();
+        },
+        lane);
+  });
+}
+
+EJoyReturn EndpointGroup::GBAWriteAsync(ReadWriteBuffer src, FGBAGroupCallback&& callback, EJoyLane lane) {
+  return broadcast(std::move(callback), {}, [src, lane](Endpoint& endpoint, const auto& state,
+                                                        GroupResult::Member& member) {
+    return endpoint.GBAWriteAsync(
+        src, &member.jstat,
+        [state, &member](ThreadLocalEndpoint&, EJoyReturn status) {
+          member.status = status;
+          state->complete();
+        },
+        lane);
+  });
+}
+
+EJoyReturn EndpointGroup::GBAWriteBlockAsync(std::span<const u8> src, FGBAGroupCallback&& callback, bool gate) {
+  return broadcast(std::move(callback), src, [gate](Endpoint& endpoint, const auto& state,
+                                                    GroupResult::Member& member) {
+    return endpoint.GBAWriteBlockAsync(
+        state->payload, &member.jstat,
+        [state, &member](ThreadLocalEndpoint&, EJoyReturn status, size_t transferred) {
+          member.status = status;
+          member.transferred = transferred;
+          state->complete();
+        },
+        gate);
+  });
+}
+
+} // namespace jbus
@@ -0,0 +1,174 @@
+#include "jbus/LinkConditioner.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+namespace jbus::net {
+
+bool LinkConditionerOptions::Parse(const char* spec, LinkConditionerOptions& optionsOut) {
+  LinkConditionerOptions options;
+  while (*spec) {
+    const char* eq = strchr(spec, '=');
+    if (!eq)
+      return false;
+    char* end;
+    const unsigned long long value = strtoull(eq + 1, &end, 0);
+    if (end == eq + 1 || (*end && *end != ','))
+      return false;
+
+    const size_t keyLen = eq - spec;
+    auto key = [&](const char* name) { return keyLen == strlen(name) && !strncmp(spec, name, keyLen); };
+    if (key("latency"))
+      options.latencyUs = u32(value);
+    else if (key("jitter"))
+      options.jitterUs = u32(value);
+    else if (key("rate"))
+      options.bytesPerSec = u32(value);
+    else if (key("chunk"))
+      options.maxChunk = u32(value);
+    else if (key("seed"))
+      options.seed = value;
+    else
+      return false;
+
+    spec = *end ? end + 1 : end;
+  }
+  optionsOut = options;
+  return true;
+}
+
+LinkConditioner::LinkConditioner(const LinkConditionerOptions& options)
+: m_options(options)
+, m_rngState(options.seed)
+, m_latencyTicks(u64(options.latencyUs) * GetGCTicksPerSec() / 1000000)
+, m_jitterTicks(u64(options.jitterUs) * GetGCTicksPerSec() / 1000000) {}
+
+u64 LinkConditioner::nextRandom(u64 bound) noexcept {
+  /* splitmix64; uniform enough for test impairments and identical on every platform */
+  u64 z = (m_rngState += 0x9e3779b97f4a7c15ull);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+  z ^= z >> 31;
+  return z % (bound + 1);
+}
+
+size_t LinkConditioner::chunkSize(size_t len) noexcept {
+  if (!m_options.maxChunk || len <= 1)
+    return len;
+  return 1 + size_t(nextRandom(std::min<size_t>(len, m_options.maxChunk) - 1));
+}
+
+Socket::EResult LinkConditioner::send(Socket& socket, const void* buf, size_t len, size_t& transferred) noexcept {
+  if (!m_options.maxChunk || !buf || !len)
+    return socket.rawSend(buf, len, transferred);
+
+  transferred = 0;
+  while (transferred < len) {
+    size_t sent = 0;
+    const Socket::EResult result =
+        socket.rawSend(static_cast<const u8*>(buf) + transferred, chunkSize(len - transferred), sent);
+    transferred += sent;
+    if (result != Socket::EResult::OK)
+      return result;
+  }
+  return Socket::EResult::OK;
+}
+
+Socket::EResult LinkConditioner::ingest(Socket& socket) noexcept {
+  /* Move pending bytes to the front once the tail has no room left */
+  if (m_heldOffset == m_heldEnd) {
+    m_heldOffset = 0;
+    m_heldEnd = 0;
+  } else if (m_heldEnd == HeldCapacity) {
+    memmove(m_held.data(), m_held.data() + m_heldOffset, m_heldEnd - m_heldOffset);
+    m_heldEnd -= m_heldOffset;
+    m_heldOffset = 0;
+  }
+
+  size_t received = 0;
+  const Socket::EResult result =
+      socket.rawRecv(m_held.data() + m_heldEnd, std::min<size_t>(HeldCapacity - m_heldEnd, 512), received);
+  if (result != Socket::EResult::OK)
+    return result;
+
+  const u64 now = GetGCTicks();
+  u64 sentTicks = now;
+  if (m_options.bytesPerSec) {
+    /* Bytes queue behind earlier ones on the capped link */
+    sentTicks = std::max(now, m_linkFreeTicks) + received * GetGCTicksPerSec() / m_options.bytesPerSec;
+    m_linkFreeTicks = sentTicks;
+  }
+  u64 dueTicks = sentTicks + m_latencyTicks;
+  if (m_jitterTicks)
+    dueTicks += nextRandom(m_jitterTicks);
+
+  /* TCP never reorders, so jitter may delay a segment but not let it overtake */
+  dueTicks = std::max(dueTicks, m_lastDueTicks);
+  m_lastDueTicks = dueTicks;
+
+  m_heldEnd += received;
+  m_segments[(m_segmentHead + m_segmentCount++) % SegmentCapacity] = {dueTicks, received};
+  return Socket::EResult::OK;
+}
+
+Socket::EResult LinkConditioner::recv(Socket& socket, void* buf, size_t len, size_t& transferred) noexcept {
+  transferred = 0;
+  if (!socket.isOpen() || !buf)
+    return Socket::EResult::Error;
+  if (!len)
+    return Socket::EResult::OK;
+
+  /* Stamp bytes when they arrive, not when the caller gets around to asking for them */
+  if (!m_segmentCount || (!full() && socket.rawReadable())) {
+    const Socket::EResult result = ingest(socket);
+    /* Bytes already held are still delivered before a hang-up is reported */
+    if (result != Socket::EResult::OK && !m_segmentCount)
+      return result;
+  }
+
+  u64 now = GetGCTicks();
+  const u64 dueTicks = nextDelivery();
+  if (dueTicks > now) {
+    if (!socket.isBlocking())
+      return Socket::EResult::Busy;
+    WaitGCTicks(dueTicks - now);
+    now = std::max(GetGCTicks(), dueTicks);
+  }
+
+  size_t available = 0;
+  for (size_t i = 0; i < m_segmentCount; ++i) {
+    const Segment& segment = m_segments[(m_segmentHead + i) % SegmentCapacity];
+    if (segment.dueTicks > now)
+      break;
+    available += segment.size;
+  }
+
+  const size_t count = chunkSize(std::min(len, available));
+  memcpy(buf, m_held.data() + m_heldOffset, count);
+  m_heldOffset += count;
+  transferred = count;
+
+  for (size_t consumed = count; consumed;) {
+    Segment& front = m_segments[m_segmentHead];
+    const size_t take = std::min(consumed, front.size);
+    front.size -= take;
+    consumed -= take;
+    if (!front.size) {
+      m_segmentHead = (m_segmentHead + 1) % SegmentCapacity;
+      --m_segmentCount;
+    }
+  }
+  return Socket::EResult::OK;
+}
+
+void LinkConditioner::reset() {
+  m_heldOffset = 0;
+  m_heldEnd = 0;
+  m_segmentHead = 0;
+  m_segmentCount = 0;
+  m_linkFreeTicks = 0;
+  m_lastDueTicks = 0;
+}
+
+} // namespace jbus::net
@@ -1,9 +1,13 @@
 #include "jbus/Listener.hpp"
 
+#include <algorithm>
+#include <chrono>
 #include <cstdint>
+#include <functional>
 
 #include "jbus/Common.hpp"
 #include "jbus/Endpoint.hpp"
+#include "Probes.hpp"
 
 #define LOG_LISTENER 0
 
@@ -12,99 +16,341 @@
 #endif
 
 namespace jbus {
-constexpr uint32_t DataPort = 0xd6ba;
-constexpr uint32_t ClockPort = 0xc10c;
+/* Serializes binds of listener shards; shards in other processes are not covered,
+ * which is why ListenerOptions::shardCount requires a single process */
+static std::mutex BindLock;
 
 void Listener::listenerProc() {
 #if LOG_LISTENER
   printf("JoyBus listener started\n");
 #endif
 
-  net::IPAddress localhost("127.0.0.1");
+  net::IPAddress bindAddress(m_options.bindAddress);
+  bool sharded = m_options.shardCount > 1;
   bool dataBound = false;
   bool clockBound = false;
   while (m_running && (!dataBound || !clockBound)) {
-    if (!dataBound) {
-      if (!(dataBound = m_dataServer.openAndListen(localhost, DataPort))) {
-        m_dataServer = net::Socket(false);
+    {
+      /* Shards must join the data and clock reuseport groups at the same index,
+       * so one shard binds both ports before the next may bind either */
+      std::unique_lock lk{BindLock};
+      if (!dataBound) {
+        if (!(dataBound = m_dataServer.openAndListen(bindAddress, m_options.dataPort, m_options.backlog, sharded))) {
+          m_dataServer = net::Socket(false);
 #if LOG_LISTENER
-        printf("data open failed %s; will retry\n", strerror(errno));
+          printf("data open failed %s; will retry\n", strerror(errno));
 #endif
-        WaitGCTicks(GetGCTicksPerSec());
-      } else {
+        } else {
+          /* Accepted sockets inherit buffer sizes from the listener, which sizes the advertised window */
+          m_dataServer.applyOptions(m_options.socketOptions);
 #if LOG_LISTENER
-        printf("data listening on port %u\n", DataPort);
+          printf("data listening on port %u\n", m_options.dataPort);
 #endif
+        }
       }
-    }
-    if (!clockBound) {
-      if (!(clockBound = m_clockServer.openAndListen(localhost, ClockPort))) {
-        m_clockServer = net::Socket(false);
+      if (!clockBound) {
+        if (!(clockBound = m_clockServer.openAndListen(bindAddress, m_options.clockPort, m_options.backlog, sharded))) {
+          m_clockServer = net::Socket(false);
 #if LOG_LISTENER
-        printf("clock open failed %s; will retry\n", strerror(errno));
+          printf("clock open failed %s; will retry\n", strerror(errno));
 #endif
-        WaitGCTicks(GetGCTicksPerSec());
-      } else {
+        } else {
+          /* Accepted sockets inherit buffer sizes from the listener, which sizes the advertised window */
+          m_clockServer.applyOptions(m_options.socketOptions);
 #if LOG_LISTENER
-        printf("clock listening on port %u\n", ClockPort);
+          printf("clock listening on port %u\n", m_options.clockPort);
 #endif
+        }
+      }
+
+      if (sharded && dataBound != clockBound) {
+        /* Never leave a shard in only one group; retry both together */
+        m_dataServer = net::Socket(false);
+        m_clockServer = net::Socket(false);
+        dataBound = clockBound = false;
+      } else if (sharded && dataBound && clockBound) {
+        m_dataServer.attachReusePortSteering(m_options.shardCount);
+        m_clockServer.attachReusePortSteering(m_options.shardCount);
       }
     }
+
+    if (!dataBound || !clockBound)
+      net::Socket::WaitReadable(nullptr, 0, 1000, &m_wake);
   }
 
-  /* We use blocking I/O since we have a dedicated transfer thread */
-  net::Socket acceptData{true};
-  net::Socket acceptClock{true};
-  std::string hostname;
+  /* Accepted sockets use blocking I/O since we have a dedicated transfer thread.
+   * Server sockets are non-blocking so every pending connection is drained each cycle. */
+  const net::Socket* servers[] = {&m_dataServer, &m_clockServer};
   while (m_running) {
-    if (m_dataServer.accept(acceptData, hostname) == net::Socket::EResult::OK) {
+    net::Socket::WaitReadable(servers, 2, 1000, &m_wake);
+    /* Stop is re-checked by the loop, so consuming its signal here is harmless */
+    m_wake.reset();
+    flushOverflow();
+    drainAccepts(m_dataServer, false);
+    drainAccepts(m_clockServer, true);
+    pairPending();
+  }
+
+  m_pending.clear();
+  m_dataServer.close();
+  m_clockServer.close();
 #if LOG_LISTENER
-      printf("accepted data connection from %s\n", hostname.c_str());
+  printf("JoyBus listener stopped\n");
 #endif
+}
+
+void Listener::drainAccepts(net::Socket& server, bool clock) {
+  while (true) {
+    PendingSocket accepted;
+    uint16_t port;
+    if (server.accept(accepted.socket, accepted.address, port) != net::Socket::EResult::OK)
+      break;
+    accepted.acceptTicks = GetGCTicks();
+    accepted.socket.applyOptions(m_options.socketOptions);
+    JBUS_PROBE3(accept, accepted.address.toInteger(), port, clock);
+#if LOG_LISTENER
+    printf("accepted %s connection from %s:%u\n", clock ? "clock" : "data", accepted.address.toString().c_str(), port);
+#endif
+    PendingPeer& peer = m_pending[accepted.address.toInteger()];
+    (clock ? peer.clock : peer.data).push_back(std::move(accepted));
+  }
+}
+
+void Listener::pairPending() {
+  u64 now = GetGCTicks();
+  for (auto it = m_pending.begin(); it != m_pending.end();) {
+    PendingPeer& peer = it->second;
+
+    /* Halves from one host are matched in arrival order */
+    while (!peer.data.empty() && !peer.clock.empty()) {
+      PendingSocket data = std::move(peer.data.front());
+      PendingSocket clock = std::move(peer.clock.front());
+      peer.data.pop_front();
+      peer.clock.pop_front();
+      u64 latency = std::max(data.acceptTicks, clock.acceptTicks) - std::min(data.acceptTicks, clock.acceptTicks);
+      JBUS_PROBE2(pair, data.address.toInteger(), latency);
+
+      if (m_options.hostnameCallback) {
+        {
+          std::unique_lock lk{m_resolver->lock};
+          m_resolver->queue.push(data.address);
+        }
+        m_resolver->cv.notify_one();
+      }
+
+      bool reattached = false;
+      if (m_options.reattachHandler && m_options.reattachHandler(data.socket, clock.socket, data.address))
+        reattached = true;
+      else if (m_options.pairHandler)
+        m_options.pairHandler(data.socket, clock.socket, data.address);
+      else
+        publishEndpoint(std::make_unique<Endpoint>(0, std::move(data.socket), std::move(clock.socket), data.address,
+                                                   m_options.endpointOptions));
+      std::unique_lock lk{m_statsLock};
+      ++m_stats.paired;
+      m_stats.reattached += reattached;
+      m_stats.lastLatencyTicks = latency;
+      m_stats.maxLatencyTicks = std::max(m_stats.maxLatencyTicks, latency);
+      m_stats.totalLatencyTicks += latency;
     }
-    if (m_clockServer.accept(acceptClock, hostname) == net::Socket::EResult::OK) {
+
+    /* Close halves whose counterpart never arrived */
+    u64 orphaned = 0;
+    for (auto* halves : {&peer.data, &peer.clock}) {
+      while (!halves->empty() && now - halves->front().acceptTicks >= m_options.pairTimeoutTicks) {
 #if LOG_LISTENER
-      printf("accepted clock connection from %s\n", hostname.c_str());
+        printf("closing unpaired %s connection from %s\n", halves == &peer.clock ? "clock" : "data",
+               halves->front().address.toString().c_str());
 #endif
+        halves->pop_front();
+        ++orphaned;
+      }
+    }
+    if (orphaned) {
+      JBUS_PROBE2(orphan, it->first, orphaned);
+      std::unique_lock lk{m_statsLock};
+      m_stats.orphaned += orphaned;
     }
-    if (acceptData && acceptClock) {
-      std::unique_lock lk{m_queueLock};
-      m_endpointQueue.push(std::make_unique<Endpoint>(0, std::move(acceptData), std::move(acceptClock)));
+
+    if (peer.data.empty() && peer.clock.empty())
+      it = m_pending.erase(it);
+    else
+      ++it;
+  }
+}
+
+void Listener::publishEndpoint(std::unique_ptr<Endpoint>&& endpoint) {
+  /* Preserve accept order behind endpoints that did not fit earlier */
+  if (!m_overflow.empty() || !m_endpointQueue.tryPush(std::move(endpoint))) {
+    if (m_overflow.size() >= m_options.overflowCapacity) {
+      /* Destroying the endpoint closes both sockets; the emulator may retry */
+      endpoint.reset();
+      std::unique_lock lk{m_statsLock};
+      ++m_stats.refused;
+      return;
     }
-    WaitGCTicks(GetGCTicksPerSec());
+    m_overflow.push_back(std::move(endpoint));
+    m_overflowPending.store(true, std::memory_order_relaxed);
+
+    /* Pairs with the fence in notifyPopped: either a consumer sees the flag or we see its free slot */
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    flushOverflow();
+    return;
   }
 
-  m_dataServer.close();
-  m_clockServer.close();
+  /* Pairs with the fence in acceptWait so either the waiter sees the endpoint or we see the waiter */
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (m_waiters.load(std::memory_order_relaxed)) {
+    std::unique_lock lk{m_waitLock};
+    m_waitCv.notify_one();
+  }
+}
+
+void Listener::flushOverflow() {
+  bool pushed = false;
+  while (!m_overflow.empty() && m_endpointQueue.tryPush(std::move(m_overflow.front()))) {
+    m_overflow.pop_front();
+    pushed = true;
+  }
+  if (m_overflow.empty())
+    m_overflowPending.store(false, std::memory_order_relaxed);
+
+  if (pushed) {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (m_waiters.load(std::memory_order_relaxed)) {
+      std::unique_lock lk{m_waitLock};
+      m_waitCv.notify_all();
+    }
+  }
+}
+
+void Listener::notifyPopped() {
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (m_overflowPending.load(std::memory_order_relaxed))
+    m_wake.signal();
+}
+
+void Listener::resolverProc(std::shared_ptr<Resolver> resolver) {
+  std::unique_lock lk{resolver->lock};
+  while (true) {
+    resolver->cv.wait(lk, [&resolver]() { return !resolver->queue.empty() || !resolver->running; });
+    if (!resolver->running)
+      break;
+    net::IPAddress address = resolver->queue.front();
+    resolver->queue.pop();
+
+    /* Name lookups may block for seconds; keep them off the accept path */
+    lk.unlock();
+    std::string hostname = address.resolveHostname();
 #if LOG_LISTENER
-  printf("JoyBus listener stopped\n");
+    printf("%s resolved to %s\n", address.toString().c_str(), hostname.c_str());
 #endif
+    lk.lock();
+
+    /* Callbacks run under the lock so none can start once stop() returns */
+    if (!resolver->running)
+      break;
+    resolver->callback(address, hostname);
+  }
 }
 
-void Listener::start() {
+bool Listener::start() {
   stop();
+  m_wake.reset();
   m_running = true;
-  m_listenerThread = std::thread(&Listener::listenerProc, this);
+  if (m_options.hostnameCallback) {
+    m_resolver = std::make_shared<Resolver>();
+    m_resolver->callback = m_options.hostnameCallback;
+    m_resolverThread = std::thread(&Listener::resolverProc, m_resolver);
+  }
+  if (!m_listenerThread.start(m_options.listenerThread, std::bind(&Listener::listenerProc, this))) {
+    stop();
+    return false;
+  }
+  return true;
 }
 
-void Listener::stop() {
+void Listener::requestStop() {
   m_running = false;
+  m_wake.signal();
+
+  {
+    std::unique_lock lk{m_waitLock};
+    m_waitCv.notify_all();
+  }
+
+  if (m_resolver) {
+    {
+      std::unique_lock lk{m_resolver->lock};
+      m_resolver->running = false;
+    }
+    m_resolver->cv.notify_one();
+  }
+}
+
+void Listener::stop() {
+  requestStop();
   if (m_listenerThread.joinable())
     m_listenerThread.join();
+
+  /* A resolver stuck in DNS finishes on its own; it holds the shared queue alive */
+  if (m_resolverThread.joinable())
+    m_resolverThread.detach();
+  m_resolver.reset();
 }
 
 std::unique_ptr<Endpoint> Listener::accept() {
-  std::unique_lock lk{m_queueLock};
-  if (m_endpointQueue.empty()) {
-    return nullptr;
+  std::unique_ptr<Endpoint> ret;
+  if (m_endpointQueue.tryPop(ret))
+    notifyPopped();
+  return ret;
+}
+
+std::unique_ptr<Endpoint> Listener::acceptWait(u64 deadlineTicks) {
+  std::unique_ptr<Endpoint> ret;
+  if (m_endpointQueue.tryPop(ret)) {
+    notifyPopped();
+    return ret;
   }
 
-  auto ret = std::move(m_endpointQueue.front());
-  m_endpointQueue.pop();
+  std::unique_lock lk{m_waitLock};
+  m_waiters.fetch_add(1);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  while (!m_endpointQueue.tryPop(ret) && m_running) {
+    u64 now = GetGCTicks();
+    if (now >= deadlineTicks)
+      break;
+    /* Wait in bounded slices so distant deadlines cannot overflow the duration */
+    u64 waitUs = std::min((deadlineTicks - now) / (GetGCTicksPerSec() / 1000000), u64(1000000));
+    m_waitCv.wait_for(lk, std::chrono::microseconds(waitUs + 1));
+  }
+  m_waiters.fetch_sub(1);
+  if (ret)
+    notifyPopped();
   return ret;
 }
 
-Listener::Listener() = default;
+size_t Listener::acceptAll(std::vector<std::unique_ptr<Endpoint>>& out) {
+  size_t count = 0;
+  std::unique_ptr<Endpoint> endpoint;
+  while (m_endpointQueue.tryPop(endpoint)) {
+    out.push_back(std::move(endpoint));
+    ++count;
+  }
+  if (count)
+    notifyPopped();
+  return count;
+}
+
+ListenerStats Listener::getStats() {
+  std::unique_lock lk{m_statsLock};
+  return m_stats;
+}
+
+Listener::Listener() : m_endpointQueue(m_options.queueCapacity) {}
+
+Listener::Listener(const ListenerOptions& options)
+: m_options(options), m_endpointQueue(m_options.queueCapacity) {}
 
 Listener::~Listener() { stop(); }
 
@@ -0,0 +1,174 @@
+#include "jbus/PollGroup.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
+#include "jbus/Endpoint.hpp"
+
+namespace jbus {
+
+/** Answers of one round, shared with the member callbacks that fill it */
+struct PollGroup::Round {
+  std::vector<u8> jstat;
+  std::vector<EJoyReturn> status;
+  std::atomic<size_t> remaining{0};
+  std::mutex lock;
+  std::condition_variable cv;
+
+  void complete() {
+    if (remaining.fetch_sub(1, std::memory_order_acq_rel) != 1)
+      return;
+    /* Taken so the waiter cannot miss the wakeup between its check and its wait */
+    std::unique_lock<std::mutex> lk(lock);
+    cv.notify_all();
+  }
+};
+
+PollGroup::PollGroup(EJoyLane lane) : m_lane(lane) {}
+
+PollGroup::~PollGroup() = default;
+
+bool PollGroup::addEndpoint(Endpoint& endpoint) {
+  if (m_roundIssued || std::find(m_members.begin(), m_members.end(), &endpoint) != m_members.end())
+    return false;
+
+  m_members.push_back(&endpoint);
+  m_jstat.push_back(0);
+  m_changes.push_back(0);
+  m_status.push_back(GBA_NOT_READY);
+  return true;
+}
+
+bool PollGroup::removeEndpoint(Endpoint& endpoint) {
+  auto it = std::find(m_members.begin(), m_members.end(), &endpoint);
+  if (m_roundIssued || it == m_members.end())
+    return false;
+
+  const size_t idx = it - m_members.begin();
+  m_members.erase(it);
+  m_jstat.erase(m_jstat.begin() + idx);
+  m_changes.erase(m_changes.begin() + idx);
+  m_status.erase(m_status.begin() + idx);
+  return true;
+}
+
+EJoyReturn PollGroup::pollAsync() {
+  if (m_members.empty())
+    return GBA_NOT_READY;
+  if (m_roundIssued)
+    return GBA_BUSY;
+
+  /* Reuse the previous round's storage once no member callback holds it anymore */
+  if (!m_round || m_round.use_count() > 1)
+    m_round = std::make_shared<Round>();
+  Round& round = *m_round;
+  const size_t count = m_members.size();
+  round.jstat.assign(count, 0);
+  round.status.assign(count, GBA_NOT_READY);
+  /* The extra count holds completion back until every member has been submitted to */
+  round.remaining.store(count + 1, std::memory_order_relaxed);
+  m_roundIssued = true;
+
+  for (size_t i = 0; i < count; ++i) {
+    auto callback = [round = m_round, i](ThreadLocalEndpoint&, EJoyReturn status) {
+      round->status[i] = status;
+      round->complete();
+    };
+    const EJoyReturn ret = m_command == ECommand::Reset
+                               ? m_members[i]->GBAResetAsync(&round.jstat[i], std::move(callback), m_lane)
+                               : m_members[i]->GBAGetStatusAsync(&round.jstat[i], std::move(callback), m_lane);
+    if (ret != GBA_READY)
+      round.remaining.fetch_sub(1, std::memory_order_relaxed);
+  }
+
+  /* Polled members send now rather than on the host's next pass */
+  const u64 now = GetGCTicks();
+  for (Endpoint* member : m_members)
+    if (member->isPolled())
+      member->process(now);
+
+  round.complete();
+  return GBA_READY;
+}
+
+bool PollGroup::collect() {
+  if (!m_roundIssued || m_round->remaining.load(std::memory_order_acquire))
+    return false;
+
+  const Round& round = *m_round;
+  for (size_t i = 0; i < m_members.size(); ++i) {
+    m_status[i] = round.status[i];
+    if (round.status[i] != GBA_READY) {
+      m_changes[i] = 0;
+      continue;
+    }
+    m_changes[i] = m_jstat[i] ^ round.jstat[i];
+    m_jstat[i] = round.jstat[i];
+  }
+  m_roundIssued = false;
+  return true;
+}
+
+bool PollGroup::waitRound(u64 deadline) {
+  const bool anyPolled =
+      std::any_of(m_members.begin(), m_members.end(), [](const Endpoint* member) { return member->isPolled(); });
+  Round& round = *m_round;
+  for (;;) {
+    u64 now = GetGCTicks();
+    if (anyPolled) {
+      for (Endpoint* member : m_members)
+        if (member->isPolled())
+          member->process(now);
+      now = GetGCTicks();
+    }
+
+    std::unique_lock<std::mutex> lk(round.lock);
+    if (!round.remaining.load(std::memory_order_acquire))
+      return true;
+    if (now >= deadline)
+      return false;
+
+    /* Polled members only progress when processed, so wake often enough to drive them */
+    u64 waitTicks = deadline - now;
+    if (anyPolled)
+      waitTicks = std::min(waitTicks, GetGCTicksPerSec() / 2000);
+    round.cv.wait_for(lk, std::chrono::microseconds(waitTicks * 1000000 / GetGCTicksPerSec() + 1));
+  }
+}
+
+EJoyReturn PollGroup::poll(u64 timeoutTicks) {
+  if (m_members.empty())
+    return GBA_NOT_READY;
+
+  const u64 deadline = GetGCTicks() + timeoutTicks;
+  if (!m_roundIssued)
+    pollAsync();
+  if (!waitRound(deadline))
+    return GBA_BUSY;
+
+  collect();
+  return GBA_READY;
+}
+
+int PollGroup::waitAny(u8 mask, u8 match, u64 timeoutTicks, u64 intervalTicks) {
+  const u64 deadline = GetGCTicks() + timeoutTicks;
+  for (;;) {
+    const u64 now = GetGCTicks();
+    if (now >= deadline || poll(deadline - now) != GBA_READY)
+      return -1;
+
+    for (size_t i = 0; i < m_members.size(); ++i)
+      if (m_status[i] == GBA_READY && (m_jstat[i] & mask) == match)
+        return int(i);
+
+    const u64 next = GetGCTicks();
+    if (next >= deadline)
+      return -1;
+    WaitGCTicks(std::min(intervalTicks, deadline - next));
+  }
+}
+
+} // namespace jbus
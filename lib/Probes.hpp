@@ -0,0 +1,61 @@
+#pragma once
+
+/* Static USDT tracepoints under the "jbus" provider.
+ *
+ * With systemtap's <sys/sdt.h> available, each probe compiles to a single nop plus an
+ * ELF note describing its arguments; nothing runs until a tracer attaches, e.g.
+ *
+ *   bpftrace -e 'usdt:./joyboot:jbus:receive { @[arg1] = hist(arg3); }'
+ *
+ * Without the header, or when configured with JBUS_USDT_PROBES=OFF, probes expand to nothing.
+ * Arguments must be integers or pointers.
+ *
+ * Probes:
+ *   cmd_submit(chan, cmd)                      command or block stream queued by the caller
+ *   clock_sync(chan, tickDelta)                GBA clock delta sent ahead of a command
+ *   send(chan, cmd, bytes)                     command bytes written to the data socket
+ *   receive(chan, cmd, bytes, expected)        response bytes read from the data socket
+ *   callback_start(chan, status)               completion callback about to run
+ *   callback_done(chan, status)                completion callback returned
+ *   joyboot_phase(chan, phase, bytesSent)      JoyBoot entered a phase (see EJoyBootProbePhase)
+ *   accept(address, port, clock)               listener accepted a data (clock=0) or clock (clock=1) socket
+ *   pair(address, latencyTicks)                listener matched a data/clock pair
+ *   orphan(address, count)                     listener closed halves whose counterpart never arrived
+ */
+
+#if !defined(JBUS_NO_PROBES) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define JBUS_HAVE_PROBES 1
+#endif
+#endif
+
+#if JBUS_HAVE_PROBES
+#define JBUS_PROBE1(name, a) DTRACE_PROBE1(jbus, name, a)
+#define JBUS_PROBE2(name, a, b) DTRACE_PROBE2(jbus, name, a, b)
+#define JBUS_PROBE3(name, a, b, c) DTRACE_PROBE3(jbus, name, a, b, c)
+#define JBUS_PROBE4(name, a, b, c, d) DTRACE_PROBE4(jbus, name, a, b, c, d)
+#else
+#define JBUS_PROBE1(name, a) ((void)0)
+#define JBUS_PROBE2(name, a, b) ((void)0)
+#define JBUS_PROBE3(name, a, b, c) ((void)0)
+#define JBUS_PROBE4(name, a, b, c, d) ((void)0)
+#endif
+
+namespace jbus {
+
+/** Phase argument of the joyboot_phase probe. */
+enum EJoyBootProbePhase {
+  JOYBOOT_PROBE_START = 0,
+  JOYBOOT_PROBE_RESET = 1,
+  JOYBOOT_PROBE_STATUS = 2,
+  JOYBOOT_PROBE_CHALLENGE = 3,
+  JOYBOOT_PROBE_KEY = 4,
+  JOYBOOT_PROBE_TRANSMIT_START = 5,
+  JOYBOOT_PROBE_TRANSMIT_END = 6,
+  JOYBOOT_PROBE_BOOT_POLL = 7,
+  JOYBOOT_PROBE_ACKNOWLEDGE = 8,
+  JOYBOOT_PROBE_FINISH = 9
+};
+
+} // namespace jbus
@@ -0,0 +1,193 @@
+#include "jbus/RomImage.hpp"
+
+#include <cstdio>
+
+#include <sys/stat.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#else
+#include <Windows.h>
+#endif
+
+namespace jbus {
+
+namespace {
+bool StatFile(const std::string& path, s64& mtimeOut, size_t& sizeOut) {
+#ifdef _WIN32
+  struct _stat64 st;
+  if (_stat64(path.c_str(), &st) != 0)
+    return false;
+  mtimeOut = s64(st.st_mtime) * 1000000000;
+#else
+  struct stat st;
+  if (stat(path.c_str(), &st) != 0)
+    return false;
+#if __APPLE__
+  mtimeOut = s64(st.st_mtimespec.tv_sec) * 1000000000 + st.st_mtimespec.tv_nsec;
+#else
+  mtimeOut = s64(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+#endif
+#endif
+  sizeOut = size_t(st.st_size);
+  return true;
+}
+
+/* The BIOS rejects images whose complement byte does not match the header */
+void ClientPadComplementCheck(u8* buffer) {
+  u8 check = 0x19;
+  for (int i = 0xa0; i < 0xbd; ++i)
+    check += buffer[i];
+  buffer[0xbd] = -check;
+}
+} // namespace
+
+RomImage::~RomImage() {
+  if (m_heap)
+    return;
+#ifndef _WIN32
+  if (m_data)
+    munmap(const_cast<u8*>(m_data), m_size);
+#else
+  if (m_data)
+    UnmapViewOfFile(m_data);
+  if (m_mapping)
+    CloseHandle(m_mapping);
+#endif
+}
+
+std::shared_ptr<const RomImage> RomImage::Open(const std::string& path, EResult* resultOut) {
+  auto fail = [resultOut](EResult result) -> std::shared_ptr<const RomImage> {
+    if (resultOut)
+      *resultOut = result;
+    return {};
+  };
+
+  std::shared_ptr<RomImage> image(new RomImage());
+  image->m_path = path;
+  if (!StatFile(path, image->m_mtime, image->m_size))
+    return fail(EResult::OpenFailed);
+  if (image->m_size < MinSize)
+    return fail(EResult::TooSmall);
+  if (image->m_size >= MaxSize)
+    return fail(EResult::TooLarge);
+
+  u8* data = nullptr;
+#ifndef _WIN32
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd == -1)
+    return fail(EResult::OpenFailed);
+  /* Private writable mapping: patching the header copies a single page, the file is never modified */
+  void* map = mmap(nullptr, image->m_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map != MAP_FAILED) {
+    data = static_cast<u8*>(map);
+    image->m_data = data;
+  }
+#else
+  HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                            FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file == INVALID_HANDLE_VALUE)
+    return fail(EResult::OpenFailed);
+  image->m_mapping = CreateFileMappingA(file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+  CloseHandle(file);
+  if (image->m_mapping) {
+    data = static_cast<u8*>(MapViewOfFile(image->m_mapping, FILE_MAP_COPY, 0, 0, image->m_size));
+    image->m_data = data;
+  }
+#endif
+
+  if (!data) {
+    /* Filesystems without mmap support still work, at the cost of a copy */
+    FILE* fp = fopen(path.c_str(), "rb");
+    if (!fp)
+      return fail(EResult::OpenFailed);
+    image->m_heap.reset(new u8[image->m_size]);
+    size_t read = fread(image->m_heap.get(), 1, image->m_size, fp);
+    fclose(fp);
+    if (read != image->m_size)
+      return fail(EResult::OpenFailed);
+    data = image->m_heap.get();
+    image->m_data = data;
+  }
+
+  /* Same check GBAJoyBootAsync applies; done once here instead of on every boot */
+  if (data[0xac] * data[0xac] * data[0xac] * data[0xac] == 0)
+    return fail(EResult::BadHeader);
+
+  ClientPadComplementCheck(data);
+#ifndef _WIN32
+  if (!image->m_heap)
+    mprotect(data, image->m_size, PROT_READ);
+#endif
+
+  if (resultOut)
+    *resultOut = EResult::OK;
+  return image;
+}
+
+const char* RomImage::ResultString(EResult result) {
+  switch (result) {
+  case EResult::OK:
+    return "OK";
+  case EResult::OpenFailed:
+    return "unable to open file";
+  case EResult::TooSmall:
+    return "image must be at least 512 bytes";
+  case EResult::TooLarge:
+    return "image must be smaller than 256 KiB";
+  case EResult::BadHeader:
+    return "invalid image header";
+  }
+  return "unknown error";
+}
+
+std::shared_ptr<const RomImage> RomImageCache::get(const std::string& path, RomImage::EResult* resultOut) {
+  s64 mtime;
+  size_t size;
+  bool exists = StatFile(path, mtime, size);
+
+  std::unique_lock lk(m_lock);
+  auto search = m_entries.find(path);
+  if (search != m_entries.end()) {
+    const Entry& entry = search->second;
+    if (exists && entry.mtime == mtime && entry.size == size) {
+      ++m_hits;
+      if (resultOut)
+        *resultOut = RomImage::EResult::OK;
+      return entry.image;
+    }
+    m_entries.erase(search);
+  }
+  if (!exists) {
+    if (resultOut)
+      *resultOut = RomImage::EResult::OpenFailed;
+    return {};
+  }
+
+  /* Loading only maps the file, so holding the lock here is cheap */
+  ++m_loads;
+  std::shared_ptr<const RomImage> image = RomImage::Open(path, resultOut);
+  if (image)
+    m_entries[path] = Entry{image, image->mtime(), size_t(image->size())};
+  return image;
+}
+
+void RomImageCache::clear() {
+  std::unique_lock lk(m_lock);
+  m_entries.clear();
+}
+
+u64 RomImageCache::getHits() {
+  std::unique_lock lk(m_lock);
+  return m_hits;
+}
+
+u64 RomImageCache::getLoads() {
+  std::unique_lock lk(m_lock);
+  return m_loads;
+}
+
+} // namespace jbus
@@ -1,5 +1,9 @@
 #include "jbus/Socket.hpp"
 
+#include "jbus/Common.hpp"
+#include "jbus/LinkConditioner.hpp"
+
+#include <algorithm>
 #include <cstdio>
 #include <cstring>
 
@@ -11,9 +15,14 @@
 #include <netdb.h>
 #include <netinet/in.h>
 #include <netinet/tcp.h>
+#include <poll.h>
 #include <sys/socket.h>
 #include <sys/types.h>
 #include <unistd.h>
+#ifdef __linux__
+#include <linux/filter.h>
+#include <sys/eventfd.h>
+#endif
 #else
 #include <WinSock2.h>
 #include <Ws2tcpip.h>
@@ -63,8 +72,34 @@ void IPAddress::resolve(const std::string& address) noexcept {
   }
 }
 
+IPAddress IPAddress::FromInteger(uint32_t address) noexcept {
+  IPAddress ret;
+  ret.m_address = htonl(address);
+  ret.m_valid = true;
+  return ret;
+}
+
 uint32_t IPAddress::toInteger() const noexcept { return ntohl(m_address); }
 
+std::string IPAddress::toString() const {
+  char name[INET_ADDRSTRLEN] = {};
+  in_addr addr = {};
+  addr.s_addr = m_address;
+  if (!inet_ntop(AF_INET, &addr, name, sizeof(name)))
+    return {};
+  return name;
+}
+
+std::string IPAddress::resolveHostname() const {
+  sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = m_address;
+  char name[NI_MAXHOST];
+  if (getnameinfo(reinterpret_cast<sockaddr*>(&addr), sizeof(addr), name, NI_MAXHOST, nullptr, 0, 0) == 0)
+    return name;
+  return toString();
+}
+
 static sockaddr_in createAddress(uint32_t address, unsigned short port) {
   sockaddr_in addr = {};
   addr.sin_addr.s_addr = htonl(address);
@@ -78,6 +113,62 @@ static sockaddr_in createAddress(uint32_t address, unsigned short port) {
   return addr;
 }
 
+WakeEvent::WakeEvent() noexcept {
+#if defined(__linux__)
+  m_readHandle = m_writeHandle = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+#elif !defined(_WIN32)
+  int fds[2];
+  if (pipe(fds) == 0) {
+    for (int fd : fds) {
+      fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+      fcntl(fd, F_SETFD, FD_CLOEXEC);
+    }
+    m_readHandle = fds[0];
+    m_writeHandle = fds[1];
+  }
+#endif
+}
+
+WakeEvent::~WakeEvent() noexcept {
+#ifndef _WIN32
+  if (m_writeHandle != -1 && m_writeHandle != m_readHandle)
+    ::close(m_writeHandle);
+  if (m_readHandle != -1)
+    ::close(m_readHandle);
+#endif
+}
+
+void WakeEvent::signal() noexcept {
+#if defined(__linux__)
+  uint64_t one = 1;
+  if (m_writeHandle != -1)
+    (void)!::write(m_writeHandle, &one, sizeof(one));
+#elif !defined(_WIN32)
+  char one = 1;
+  if (m_writeHandle != -1)
+    (void)!::write(m_writeHandle, &one, 1);
+#endif
+}
+
+void WakeEvent::reset() noexcept {
+#ifndef _WIN32
+  char drain[64];
+  if (m_readHandle != -1)
+    while (::read(m_readHandle, drain, sizeof(drain)) > 0) {
+    }
+#endif
+}
+
+void Socket::ConditionerDeleter::operator()(LinkConditioner* conditioner) const noexcept { delete conditioner; }
+
+void Socket::setConditioner(const LinkConditionerOptions& options) {
+  m_conditioner.reset(new LinkConditioner(options));
+}
+
+void Socket::clearConditioner() noexcept { m_conditioner.reset(); }
+
+uint64_t Socket::nextDelivery() const noexcept { return m_conditioner ? m_conditioner->nextDelivery() : ~uint64_t(0); }
+
 bool Socket::openSocket() noexcept {
   if (isOpen())
     return false;
@@ -99,10 +190,105 @@ bool Socket::openSocket() noexcept {
   return true;
 }
 
-void Socket::setRemoteSocket(int remSocket) noexcept {
+void Socket::setRemoteSocket(SocketTp remSocket) noexcept {
   close();
   m_socket = remSocket;
   setBlocking(m_isBlocking);
+
+  /* Accepted sockets do not inherit TCP_NODELAY from the listener on every platform */
+  int one = 1;
+  setsockopt(m_socket, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<char*>(&one), sizeof(one));
+#ifdef __APPLE__
+  setsockopt(m_socket, SOL_SOCKET, SO_NOSIGPIPE, reinterpret_cast<char*>(&one), sizeof(one));
+#endif
+}
+
+static bool SetIntOption(Socket::SocketTp socket, int level, int name, int value) {
+  return setsockopt(socket, level, name, reinterpret_cast<char*>(&value), sizeof(value)) == 0;
+}
+
+static int GetIntOption(Socket::SocketTp socket, int level, int name) {
+  int value = 0;
+  socklen_t len = sizeof(value);
+  if (getsockopt(socket, level, name, reinterpret_cast<char*>(&value), &len) != 0)
+    return 0;
+  return value;
+}
+
+bool Socket::applyOptions(const SocketOptions& options) noexcept {
+  if (!isOpen())
+    return false;
+
+  bool ok = SetIntOption(m_socket, IPPROTO_TCP, TCP_NODELAY, options.noDelay);
+  if (options.sendBuffer)
+    ok &= SetIntOption(m_socket, SOL_SOCKET, SO_SNDBUF, options.sendBuffer);
+  if (options.recvBuffer)
+    ok &= SetIntOption(m_socket, SOL_SOCKET, SO_RCVBUF, options.recvBuffer);
+#ifdef TCP_QUICKACK
+  m_quickAck = options.quickAck;
+  if (options.quickAck)
+    ok &= SetIntOption(m_socket, IPPROTO_TCP, TCP_QUICKACK, 1);
+#endif
+#ifdef SO_BUSY_POLL
+  if (options.busyPollUs)
+    ok &= SetIntOption(m_socket, SOL_SOCKET, SO_BUSY_POLL, options.busyPollUs);
+#endif
+  ok &= SetIntOption(m_socket, SOL_SOCKET, SO_KEEPALIVE, options.keepAlive);
+  if (options.keepAlive) {
+#if defined(TCP_KEEPIDLE)
+    if (options.keepAliveIdleSec)
+      ok &= SetIntOption(m_socket, IPPROTO_TCP, TCP_KEEPIDLE, options.keepAliveIdleSec);
+#elif defined(TCP_KEEPALIVE)
+    if (options.keepAliveIdleSec)
+      ok &= SetIntOption(m_socket, IPPROTO_TCP, TCP_KEEPALIVE, options.keepAliveIdleSec);
+#endif
+#ifdef TCP_KEEPINTVL
+    if (options.keepAliveIntervalSec)
+      ok &= SetIntOption(m_socket, IPPROTO_TCP, TCP_KEEPINTVL, options.keepAliveIntervalSec);
+#endif
+#ifdef TCP_KEEPCNT
+    if (options.keepAliveCount)
+      ok &= SetIntOption(m_socket, IPPROTO_TCP, TCP_KEEPCNT, options.keepAliveCount);
+#endif
+  }
+#ifdef TCP_USER_TIMEOUT
+  if (options.userTimeoutMs)
+    ok &= SetIntOption(m_socket, IPPROTO_TCP, TCP_USER_TIMEOUT, int(options.userTimeoutMs));
+#endif
+
+  return ok;
+}
+
+SocketOptions Socket::queryOptions() const noexcept {
+  SocketOptions ret;
+  if (!isOpen())
+    return ret;
+
+  ret.noDelay = GetIntOption(m_socket, IPPROTO_TCP, TCP_NODELAY) != 0;
+  ret.sendBuffer = GetIntOption(m_socket, SOL_SOCKET, SO_SNDBUF);
+  ret.recvBuffer = GetIntOption(m_socket, SOL_SOCKET, SO_RCVBUF);
+#ifdef TCP_QUICKACK
+  ret.quickAck = m_quickAck && GetIntOption(m_socket, IPPROTO_TCP, TCP_QUICKACK) != 0;
+#endif
+#ifdef SO_BUSY_POLL
+  ret.busyPollUs = GetIntOption(m_socket, SOL_SOCKET, SO_BUSY_POLL);
+#endif
+  ret.keepAlive = GetIntOption(m_socket, SOL_SOCKET, SO_KEEPALIVE) != 0;
+#if defined(TCP_KEEPIDLE)
+  ret.keepAliveIdleSec = GetIntOption(m_socket, IPPROTO_TCP, TCP_KEEPIDLE);
+#elif defined(TCP_KEEPALIVE)
+  ret.keepAliveIdleSec = GetIntOption(m_socket, IPPROTO_TCP, TCP_KEEPALIVE);
+#endif
+#ifdef TCP_KEEPINTVL
+  ret.keepAliveIntervalSec = GetIntOption(m_socket, IPPROTO_TCP, TCP_KEEPINTVL);
+#endif
+#ifdef TCP_KEEPCNT
+  ret.keepAliveCount = GetIntOption(m_socket, IPPROTO_TCP, TCP_KEEPCNT);
+#endif
+#ifdef TCP_USER_TIMEOUT
+  ret.userTimeoutMs = unsigned(GetIntOption(m_socket, IPPROTO_TCP, TCP_USER_TIMEOUT));
+#endif
+  return ret;
 }
 
 #ifdef _WIN32
@@ -131,10 +317,20 @@ void Socket::setBlocking(bool blocking) noexcept {
 #endif
 }
 
-bool Socket::openAndListen(const IPAddress& address, uint32_t port) noexcept  {
+bool Socket::openAndListen(const IPAddress& address, uint32_t port, int backlog, bool reusePort) noexcept {
   if (!openSocket())
     return false;
 
+#ifndef _WIN32
+  /* Allow immediate rebind while connections of a previous listener linger in TIME_WAIT */
+  int one = 1;
+  setsockopt(m_socket, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<char*>(&one), sizeof(one));
+#ifdef SO_REUSEPORT
+  if (reusePort && setsockopt(m_socket, SOL_SOCKET, SO_REUSEPORT, reinterpret_cast<char*>(&one), sizeof(one)) == -1)
+    return false;
+#endif
+#endif
+
   sockaddr_in addr = createAddress(address.toInteger(), port);
   if (bind(m_socket, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == -1) {
     /* Not likely to happen, but... */
@@ -142,7 +338,7 @@ bool Socket::openAndListen(const IPAddress& address, uint32_t port) noexcept  {
     return false;
   }
 
-  if (::listen(m_socket, 0) == -1) {
+  if (::listen(m_socket, backlog) == -1) {
     /* Oops, socket is deaf */
     // fprintf(stderr, "Failed to listen to port %d\n", port);
     return false;
@@ -151,6 +347,42 @@ bool Socket::openAndListen(const IPAddress& address, uint32_t port) noexcept  {
   return true;
 }
 
+bool Socket::openAndConnect(const IPAddress& address, uint32_t port) noexcept {
+  if (!openSocket())
+    return false;
+
+  const bool blocking = m_isBlocking;
+  setBlocking(true);
+  sockaddr_in addr = createAddress(address.toInteger(), port);
+  const bool connected = ::connect(m_socket, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != -1;
+  setBlocking(blocking);
+  if (!connected)
+    close();
+
+  return connected;
+}
+
+bool Socket::attachReusePortSteering(uint32_t shardCount) noexcept {
+#if defined(__linux__) && defined(SO_ATTACH_REUSEPORT_CBPF)
+  if (!isOpen() || !shardCount)
+    return false;
+
+  /* A = IPv4 source address; return A % shardCount as the group member index */
+  sock_filter code[] = {
+      {BPF_LD | BPF_W | BPF_ABS, 0, 0, uint32_t(SKF_NET_OFF) + 12},
+      {BPF_ALU | BPF_MOD | BPF_K, 0, 0, shardCount},
+      {BPF_RET | BPF_A, 0, 0, 0},
+  };
+  sock_fprog prog = {};
+  prog.len = sizeof(code) / sizeof(code[0]);
+  prog.filter = code;
+  return setsockopt(m_socket, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof(prog)) == 0;
+#else
+  (void)shardCount;
+  return false;
+#endif
+}
+
 Socket::EResult Socket::accept(Socket& remoteSocketOut, sockaddr_in& fromAddress) noexcept {
   if (!isOpen())
     return EResult::Error;
@@ -184,6 +416,16 @@ Socket::EResult Socket::accept(Socket& remoteSocketOut) noexcept {
   return accept(remoteSocketOut, fromAddress);
 }
 
+Socket::EResult Socket::accept(Socket& remoteSocketOut, IPAddress& fromAddress, uint16_t& fromPort) noexcept {
+  sockaddr_in addr;
+  EResult res = accept(remoteSocketOut, addr);
+  if (res == EResult::OK) {
+    fromAddress = IPAddress::FromInteger(ntohl(addr.sin_addr.s_addr));
+    fromPort = ntohs(addr.sin_port);
+  }
+  return res;
+}
+
 Socket::EResult Socket::accept(Socket& remoteSocketOut, std::string& fromHostname) {
   sockaddr_in fromAddress;
   socklen_t len = sizeof(fromAddress);
@@ -195,7 +437,19 @@ Socket::EResult Socket::accept(Socket& remoteSocketOut, std::string& fromHostnam
   return res;
 }
 
+void Socket::shutdown() noexcept {
+  if (!isOpen())
+    return;
+#ifndef _WIN32
+  ::shutdown(m_socket, SHUT_RDWR);
+#else
+  ::shutdown(m_socket, SD_BOTH);
+#endif
+}
+
 void Socket::close() noexcept {
+  if (m_conditioner)
+    m_conditioner->reset();
   if (!isOpen())
     return;
 #ifndef _WIN32
@@ -206,7 +460,91 @@ void Socket::close() noexcept {
   m_socket = -1;
 }
 
+bool Socket::WaitReadable(const Socket* const* sockets, size_t count, uint32_t timeoutMs,
+                          const WakeEvent* wake) noexcept {
+  /* Input a conditioner holds is invisible to the kernel; wake when the earliest becomes due */
+  uint64_t heldDue = ~uint64_t(0);
+  for (size_t i = 0; i < count; ++i)
+    heldDue = std::min(heldDue, sockets[i]->nextDelivery());
+  if (heldDue != ~uint64_t(0)) {
+    const uint64_t now = GetGCTicks();
+    if (heldDue <= now)
+      return true;
+    const uint64_t heldMs = ((heldDue - now) * 1000 + GetGCTicksPerSec() - 1) / GetGCTicksPerSec();
+    timeoutMs = uint32_t(std::min<uint64_t>(timeoutMs, heldMs));
+  }
+
+#ifndef _WIN32
+  /* poll() has no FD_SETSIZE ceiling, which matters for hosts driving many links */
+  pollfd fds[9];
+  nfds_t nfds = 0;
+  for (size_t i = 0; i < count && nfds < 8; ++i) {
+    if (!sockets[i]->isOpen())
+      continue;
+    fds[nfds].fd = sockets[i]->m_socket;
+    fds[nfds].events = POLLIN;
+    fds[nfds].revents = 0;
+    ++nfds;
+  }
+  if (wake && wake->getHandle() != -1) {
+    fds[nfds].fd = wake->getHandle();
+    fds[nfds].events = POLLIN;
+    fds[nfds].revents = 0;
+    ++nfds;
+  }
+  if (!nfds)
+    return false;
+
+  if (::poll(fds, nfds, int(timeoutMs)) > 0)
+    return true;
+#else
+  fd_set readSet;
+  FD_ZERO(&readSet);
+  SocketTp maxSocket = 0;
+  bool any = false;
+  for (size_t i = 0; i < count; ++i) {
+    if (!sockets[i]->isOpen())
+      continue;
+    FD_SET(sockets[i]->m_socket, &readSet);
+    maxSocket = std::max(maxSocket, sockets[i]->m_socket);
+    any = true;
+  }
+  if (!any) {
+    Sleep(timeoutMs);
+    return false;
+  }
+
+  timeval tv;
+  tv.tv_sec = timeoutMs / 1000;
+  tv.tv_usec = (timeoutMs % 1000) * 1000;
+  if (select(int(maxSocket + 1), &readSet, nullptr, nullptr, &tv) > 0)
+    return true;
+#endif
+  return heldDue != ~uint64_t(0) && GetGCTicks() >= heldDue;
+}
+
+bool Socket::rawReadable() const noexcept {
+  if (!isOpen())
+    return false;
+#ifndef _WIN32
+  pollfd fd = {m_socket, POLLIN, 0};
+  return ::poll(&fd, 1, 0) > 0;
+#else
+  fd_set readSet;
+  FD_ZERO(&readSet);
+  FD_SET(m_socket, &readSet);
+  timeval tv = {};
+  return select(int(m_socket + 1), &readSet, nullptr, nullptr, &tv) > 0;
+#endif
+}
+
 Socket::EResult Socket::send(const void* buf, size_t len, size_t& transferred) noexcept {
+  if (m_conditioner)
+    return m_conditioner->send(*this, buf, len, transferred);
+  return rawSend(buf, len, transferred);
+}
+
+Socket::EResult Socket::rawSend(const void* buf, size_t len, size_t& transferred) noexcept {
   transferred = 0;
   if (!isOpen())
     return EResult::Error;
@@ -239,6 +577,12 @@ Socket::EResult Socket::send(const void* buf, size_t len) noexcept  {
 }
 
 Socket::EResult Socket::recv(void* buf, size_t len, size_t& transferred) noexcept {
+  if (m_conditioner)
+    return m_conditioner->recv(*this, buf, len, transferred);
+  return rawRecv(buf, len, transferred);
+}
+
+Socket::EResult Socket::rawRecv(void* buf, size_t len, size_t& transferred) noexcept {
   transferred = 0;
   if (!isOpen())
     return EResult::Error;
@@ -261,6 +605,12 @@ Socket::EResult Socket::recv(void* buf, size_t len, size_t& transferred) noexcep
   else if (result == 0)
     return EResult::Error;
 
+#ifdef TCP_QUICKACK
+  /* The kernel drops back to delayed ACKs on its own; re-arm after every receive */
+  if (m_quickAck)
+    SetIntOption(m_socket, IPPROTO_TCP, TCP_QUICKACK, 1);
+#endif
+
   transferred = result;
   return EResult::OK;
 }
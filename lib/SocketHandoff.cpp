@@ -0,0 +1,121 @@
+#include "jbus/SocketHandoff.hpp"
+
+#include <cstdint>
+#include <cstring>
+
+#ifndef _WIN32
+#include <cerrno>
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+namespace jbus::net {
+
+#ifndef _WIN32
+/* Regular payload accompanying the descriptors */
+struct HandoffMessage {
+  uint32_t address;
+  uint8_t valid;
+};
+
+bool SendSocketPair(int channel, Socket& data, Socket& clock, const IPAddress& peerAddress) noexcept {
+  if (!data || !clock)
+    return false;
+
+  HandoffMessage msg = {};
+  msg.address = peerAddress.toInteger();
+  msg.valid = bool(peerAddress);
+  iovec iov = {&msg, sizeof(msg)};
+
+  int fds[2] = {data.GetInternalSocket(), clock.GetInternalSocket()};
+  alignas(cmsghdr) char control[CMSG_SPACE(sizeof(fds))] = {};
+
+  msghdr hdr = {};
+  hdr.msg_iov = &iov;
+  hdr.msg_iovlen = 1;
+  hdr.msg_control = control;
+  hdr.msg_controllen = sizeof(control);
+  cmsghdr* cmsg = CMSG_FIRSTHDR(&hdr);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+  memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+#ifdef __linux__
+  const int flags = MSG_NOSIGNAL;
+#else
+  const int flags = 0;
+#endif
+  ssize_t ret;
+  do {
+    ret = sendmsg(channel, &hdr, flags);
+  } while (ret == -1 && errno == EINTR);
+  if (ret != ssize_t(sizeof(msg)))
+    return false;
+
+  /* Receiver now holds its own descriptors */
+  data.close();
+  clock.close();
+  return true;
+}
+
+bool ReceiveSocketPair(int channel, Socket& dataOut, Socket& clockOut, IPAddress& peerAddressOut) noexcept {
+  HandoffMessage msg = {};
+  iovec iov = {&msg, sizeof(msg)};
+  int fds[2] = {-1, -1};
+  alignas(cmsghdr) char control[CMSG_SPACE(sizeof(fds))] = {};
+
+  msghdr hdr = {};
+  hdr.msg_iov = &iov;
+  hdr.msg_iovlen = 1;
+  hdr.msg_control = control;
+  hdr.msg_controllen = sizeof(control);
+
+#ifdef MSG_CMSG_CLOEXEC
+  const int flags = MSG_CMSG_CLOEXEC;
+#else
+  const int flags = 0;
+#endif
+  ssize_t ret;
+  do {
+    ret = recvmsg(channel, &hdr, flags);
+  } while (ret == -1 && errno == EINTR);
+  if (ret <= 0)
+    return false;
+
+  /* Collect whatever descriptors arrived so none leak on a malformed message */
+  size_t fdCount = 0;
+  for (cmsghdr* cmsg = CMSG_FIRSTHDR(&hdr); cmsg; cmsg = CMSG_NXTHDR(&hdr, cmsg)) {
+    if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+      continue;
+    size_t count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+    for (size_t i = 0; i < count; ++i) {
+      int fd;
+      memcpy(&fd, CMSG_DATA(cmsg) + i * sizeof(int), sizeof(int));
+      if (fdCount < 2)
+        fds[fdCount++] = fd;
+      else
+        ::close(fd);
+    }
+  }
+
+  if (fdCount != 2 || ret != ssize_t(sizeof(msg)) || (hdr.msg_flags & MSG_CTRUNC)) {
+    for (size_t i = 0; i < fdCount; ++i)
+      ::close(fds[i]);
+    return false;
+  }
+
+  dataOut = Socket::Adopt(fds[0], true);
+  clockOut = Socket::Adopt(fds[1], true);
+  peerAddressOut = msg.valid ? IPAddress::FromInteger(msg.address) : IPAddress();
+  return true;
+}
+#else
+bool SendSocketPair(int, Socket&, Socket&, const IPAddress&) noexcept { return false; }
+
+bool ReceiveSocketPair(int, Socket&, Socket&, IPAddress&) noexcept { return false; }
+#endif
+
+} // namespace jbus::net
@@ -0,0 +1,190 @@
+#include "jbus/Thread.hpp"
+
+#include <algorithm>
+#include <memory>
+
+#define LOG_THREAD 0
+
+#if LOG_THREAD
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#endif
+
+#ifndef _WIN32
+#include <climits>
+#include <sched.h>
+#ifdef __linux__
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+#else
+#include <Windows.h>
+#endif
+
+namespace jbus {
+
+namespace {
+struct StartState {
+  ThreadOptions options;
+  std::function<void()> func;
+  std::atomic<bool>* applied;
+};
+
+/* Settings are applied by the new thread to itself so every platform uses the same path */
+bool ApplyOptions(const ThreadOptions& options) {
+  bool applied = true;
+#ifndef _WIN32
+  if (!options.name.empty()) {
+#if defined(__APPLE__)
+    pthread_setname_np(options.name.c_str());
+#elif defined(__linux__)
+    pthread_setname_np(pthread_self(), options.name.substr(0, 15).c_str());
+#endif
+  }
+
+#ifdef __linux__
+  if (!options.cpus.empty()) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (unsigned cpu : options.cpus)
+      if (cpu < CPU_SETSIZE)
+        CPU_SET(cpu, &set);
+    if (int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set)) {
+      applied = false;
+#if LOG_THREAD
+      fprintf(stderr, "Unable to set affinity of thread %s: %s\n", options.name.c_str(), strerror(err));
+#else
+      (void)err;
+#endif
+    }
+  }
+#endif
+
+  if (options.realtime) {
+    sched_param param = {};
+    param.sched_priority = options.realtimePriority;
+    if (int err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param)) {
+      applied = false;
+#if LOG_THREAD
+      fprintf(stderr, "Unable to make thread %s realtime: %s\n", options.name.c_str(), strerror(err));
+#else
+      (void)err;
+#endif
+    }
+  }
+#ifdef __linux__
+  else if (options.nice) {
+    /* Linux applies nice values per thread */
+    if (setpriority(PRIO_PROCESS, pid_t(syscall(SYS_gettid)), options.nice) == -1) {
+      applied = false;
+#if LOG_THREAD
+      fprintf(stderr, "Unable to set nice value of thread %s: %s\n", options.name.c_str(), strerror(errno));
+#endif
+    }
+  }
+#endif
+#else
+  if (!options.cpus.empty()) {
+    DWORD_PTR mask = 0;
+    for (unsigned cpu : options.cpus)
+      if (cpu < sizeof(mask) * 8)
+        mask |= DWORD_PTR(1) << cpu;
+    if (!SetThreadAffinityMask(GetCurrentThread(), mask)) {
+      applied = false;
+#if LOG_THREAD
+      fprintf(stderr, "Unable to set affinity of thread %s\n", options.name.c_str());
+#endif
+    }
+  }
+  if (options.realtime && !SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL)) {
+    applied = false;
+#if LOG_THREAD
+    fprintf(stderr, "Unable to make thread %s realtime\n", options.name.c_str());
+#endif
+  }
+#endif
+  return applied;
+}
+
+#ifndef _WIN32
+void* ThreadEntry(void* arg) {
+  std::unique_ptr<StartState> state(static_cast<StartState*>(arg));
+  state->applied->store(ApplyOptions(state->options));
+  state->func();
+  return nullptr;
+}
+#endif
+} // namespace
+
+bool Thread::start(const ThreadOptions& options, std::function<void()>&& func) {
+  join();
+  m_optionsApplied = false;
+
+#ifndef _WIN32
+  auto state = std::make_unique<StartState>(StartState{options, std::move(func), &m_optionsApplied});
+
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+  if (options.stackSize)
+    pthread_attr_setstacksize(&attr, std::max<size_t>(options.stackSize, PTHREAD_STACK_MIN));
+  int err = pthread_create(&m_thread, &attr, ThreadEntry, state.get());
+  pthread_attr_destroy(&attr);
+
+  /* An unusable stack size should not prevent the thread from running */
+  if (err && options.stackSize) {
+#if LOG_THREAD
+    fprintf(stderr, "Unable to create thread %s with %zu byte stack: %s\n", options.name.c_str(), options.stackSize,
+            strerror(err));
+#endif
+    err = pthread_create(&m_thread, nullptr, ThreadEntry, state.get());
+  }
+  if (err) {
+#if LOG_THREAD
+    fprintf(stderr, "Unable to create thread %s: %s\n", options.name.c_str(), strerror(err));
+#endif
+    return false;
+  }
+
+  state.release();
+  m_joinable = true;
+  return true;
+#else
+  m_thread = std::thread([this, options, func = std::move(func)]() {
+    m_optionsApplied = ApplyOptions(options);
+    func();
+  });
+  return true;
+#endif
+}
+
+bool Thread::joinable() const {
+#ifndef _WIN32
+  return m_joinable;
+#else
+  return m_thread.joinable();
+#endif
+}
+
+void Thread::join() {
+#ifndef _WIN32
+  if (!m_joinable)
+    return;
+  pthread_join(m_thread, nullptr);
+  m_joinable = false;
+#else
+  if (m_thread.joinable())
+    m_thread.join();
+#endif
+}
+
+bool Thread::isCurrent() const {
+#ifndef _WIN32
+  return m_joinable && pthread_equal(m_thread, pthread_self());
+#else
+  return m_thread.get_id() == std::this_thread::get_id();
+#endif
+}
+
+} // namespace jbus
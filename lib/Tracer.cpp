@@ -0,0 +1,228 @@
+#include "jbus/Tracer.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "jbus/ChromeTrace.hpp"
+#include "jbus/Thread.hpp"
+
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+
+namespace jbus {
+
+namespace {
+struct Event {
+  const char* name;
+  u64 startTicks;
+  u64 endTicks;
+  u32 chan;
+};
+
+/* Single-producer ring owned by one recording thread, drained by the flusher */
+struct ThreadBuffer {
+  std::unique_ptr<Event[]> events;
+  size_t mask;
+  alignas(64) std::atomic<u64> head{0};
+  alignas(64) std::atomic<u64> tail{0};
+  std::atomic<u64> dropped{0};
+  u32 tid;
+  std::string name;
+  bool named = false;
+
+  ThreadBuffer(size_t capacity, u32 tid) : tid(tid) {
+    size_t size = 2;
+    while (size < capacity)
+      size <<= 1;
+    events.reset(new Event[size]);
+    mask = size - 1;
+  }
+};
+
+struct TracerState {
+  /* Serializes Start() and Stop() */
+  std::mutex controlLock;
+
+  /* Guards everything below */
+  std::mutex lock;
+  std::condition_variable flushCv;
+  std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+  ChromeTraceWriter writer;
+  FILE* file = nullptr;
+  size_t eventsPerThread = TracerOptions().eventsPerThread;
+  unsigned flushIntervalMs = TracerOptions().flushIntervalMs;
+  u32 nextTid = 1;
+  u64 retiredDropped = 0;
+  bool stopping = false;
+
+  Thread flusher;
+};
+
+TracerState& State() {
+  static TracerState state;
+  return state;
+}
+
+std::shared_ptr<ThreadBuffer> RegisterThread() {
+  TracerState& state = State();
+  std::unique_lock lk(state.lock);
+  auto buffer = std::make_shared<ThreadBuffer>(state.eventsPerThread, state.nextTid++);
+#if defined(__linux__) || defined(__APPLE__)
+  char name[64] = {};
+  if (pthread_getname_np(pthread_self(), name, sizeof(name)) == 0 && name[0])
+    buffer->name = name;
+#endif
+  if (buffer->name.empty())
+    buffer->name = "thread " + std::to_string(buffer->tid);
+  state.buffers.push_back(buffer);
+  return buffer;
+}
+
+/* Moves buffered events into the writer and returns the JSON to append; call with state.lock held */
+std::string DrainLocked(TracerState& state) {
+  char args[24];
+  for (auto it = state.buffers.begin(); it != state.buffers.end();) {
+    ThreadBuffer& buffer = **it;
+    if (!buffer.named) {
+      state.writer.threadName(1, buffer.tid, buffer.name);
+      buffer.named = true;
+    }
+
+    u64 tail = buffer.tail.load(std::memory_order_relaxed);
+    u64 head = buffer.head.load(std::memory_order_acquire);
+    for (; tail != head; ++tail) {
+      const Event& event = buffer.events[tail & buffer.mask];
+      snprintf(args, sizeof(args), "\"chan\":%u", event.chan);
+      state.writer.complete(event.name, "endpoint", event.startTicks, event.endTicks, 1, buffer.tid, args);
+    }
+    buffer.tail.store(tail, std::memory_order_release);
+
+    /* Only the registry still holds buffers of exited threads */
+    if (it->use_count() == 1) {
+      state.retiredDropped += buffer.dropped.load(std::memory_order_relaxed);
+      it = state.buffers.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  return state.writer.drain();
+}
+
+void FlushProc() {
+  TracerState& state = State();
+  std::unique_lock lk(state.lock);
+  while (!state.stopping) {
+    state.flushCv.wait_for(lk, std::chrono::milliseconds(state.flushIntervalMs), [&state]() { return state.stopping; });
+    std::string json = DrainLocked(state);
+    FILE* file = state.file;
+    lk.unlock();
+    if (!json.empty())
+      fwrite(json.data(), 1, json.size(), file);
+    lk.lock();
+  }
+}
+} // namespace
+
+void Tracer::Record(const char* name, u32 chan, u64 startTicks, u64 endTicks) {
+  thread_local std::shared_ptr<ThreadBuffer> local;
+  if (!local)
+    local = RegisterThread();
+
+  ThreadBuffer& buffer = *local;
+  u64 head = buffer.head.load(std::memory_order_relaxed);
+  if (head - buffer.tail.load(std::memory_order_acquire) > buffer.mask) {
+    buffer.dropped.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  buffer.events[head & buffer.mask] = Event{name, startTicks, endTicks, chan};
+  buffer.head.store(head + 1, std::memory_order_release);
+}
+
+bool Tracer::Start(const char* path, const TracerOptions& options) {
+  TracerState& state = State();
+  std::unique_lock control(state.controlLock);
+  if (state.file)
+    return false;
+
+  FILE* file = fopen(path, "wb");
+  if (!file)
+    return false;
+
+  {
+    std::unique_lock lk(state.lock);
+    state.file = file;
+    state.writer = ChromeTraceWriter();
+    state.eventsPerThread = options.eventsPerThread;
+    state.flushIntervalMs = std::max(options.flushIntervalMs, 1u);
+    state.stopping = false;
+
+    /* Spans that straddled the previous Stop() do not belong in this trace */
+    for (const auto& buffer : state.buffers) {
+      buffer->tail.store(buffer->head.load(std::memory_order_acquire), std::memory_order_release);
+      buffer->named = false;
+    }
+  }
+
+  ThreadOptions threadOptions;
+  threadOptions.name = "jbus-trace";
+  if (!state.flusher.start(threadOptions, FlushProc)) {
+    fclose(file);
+    std::unique_lock lk(state.lock);
+    state.file = nullptr;
+    return false;
+  }
+
+  /* A process exiting mid-trace would otherwise hang joining the flusher from the state's destructor;
+   * handlers registered after State() was constructed run before it is destroyed */
+  static const bool stopAtExit = std::atexit(&Tracer::Stop) == 0;
+  (void)stopAtExit;
+
+  s_enabled.store(true, std::memory_order_relaxed);
+  return true;
+}
+
+void Tracer::Stop() {
+  TracerState& state = State();
+  std::unique_lock control(state.controlLock);
+  if (!state.file)
+    return;
+
+  s_enabled.store(false, std::memory_order_relaxed);
+  {
+    std::unique_lock lk(state.lock);
+    state.stopping = true;
+  }
+  state.flushCv.notify_all();
+  state.flusher.join();
+
+  std::string json;
+  FILE* file;
+  {
+    std::unique_lock lk(state.lock);
+    json = DrainLocked(state);
+    json += state.writer.finish();
+    file = state.file;
+    state.file = nullptr;
+  }
+  fwrite(json.data(), 1, json.size(), file);
+  fclose(file);
+}
+
+u64 Tracer::GetDropped() {
+  TracerState& state = State();
+  std::unique_lock lk(state.lock);
+  u64 dropped = state.retiredDropped;
+  for (const auto& buffer : state.buffers)
+    dropped += buffer->dropped.load(std::memory_order_relaxed);
+  return dropped;
+}
+
+} // namespace jbus
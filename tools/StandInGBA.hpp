@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+
+#include "jbus/Common.hpp"
+
+/* JoyBus responder standing in for a GBA emulator: answers commands the way the BIOS and a
+ * booted client_pad program do, closely enough for joyboot and benchmarks to run end to end.
+ * Challenge and key contents are fixed; the host does not verify them. Transport-agnostic,
+ * so threaded and event-loop peers share it. */
+class StandInGBA {
+public:
+  enum EJoybusCmds : jbus::u8 { CMD_RESET = 0xff, CMD_STATUS = 0x00, CMD_READ = 0x14, CMD_WRITE = 0x15 };
+
+  /** Bytes a command occupies on the wire, including the command byte. */
+  static size_t CommandSize(jbus::u8 cmd) { return cmd == CMD_WRITE ? 5 : 1; }
+
+private:
+  enum class EPhase { Idle, Reset, Transmit, BootPoll, Acknowledge, Running };
+
+  EPhase m_phase = EPhase::Idle;
+  unsigned m_transmitWords = 0;
+  unsigned m_bootPolls = 0;
+  jbus::u8 m_jstat = 0;
+  jbus::u32 m_readCounter = 0;
+
+  static size_t StatusResponse(jbus::u8 status, jbus::u8* response) {
+    response[0] = 0x00;
+    response[1] = 0x04;
+    response[2] = status;
+    return 3;
+  }
+
+public:
+  /** Answer one complete command of CommandSize(command[0]) bytes.
+   *  Writes up to 5 bytes to response and returns how many. */
+  size_t respond(const jbus::u8* command, jbus::u8* response) {
+    memset(response, 0, 5);
+    switch (command[0]) {
+    case CMD_RESET:
+    case CMD_STATUS:
+      if (m_phase == EPhase::Idle) {
+        if (command[0] == CMD_RESET)
+          m_phase = EPhase::Reset;
+        return StatusResponse(0x08, response);
+      }
+      if (m_phase == EPhase::BootPoll)
+        return StatusResponse(++m_bootPolls < 3 ? 0x00 : 0x08, response);
+      if (m_phase == EPhase::Running) {
+        /* The program consumes the written word and produces the next read word */
+        const size_t size = StatusResponse(0x28 | (m_jstat & 0x0a), response);
+        m_jstat = (m_jstat & ~0x02) | 0x08;
+        return size;
+      }
+      return StatusResponse(0x18, response);
+    case CMD_READ:
+      if (m_phase == EPhase::Reset) {
+        m_phase = EPhase::Transmit;
+        m_transmitWords = 0;
+        const jbus::u8 challenge[] = {0x12, 0x34, 0x56, 0x78, 0x38};
+        memcpy(response, challenge, sizeof(challenge));
+      } else if (m_phase == EPhase::Transmit) {
+        m_phase = EPhase::BootPoll;
+      } else if (m_phase == EPhase::BootPoll) {
+        m_phase = EPhase::Acknowledge;
+        const jbus::u8 acknowledge[] = {0xaa, 0xbb, 0xcc, 0xdd, 0x08};
+        memcpy(response, acknowledge, sizeof(acknowledge));
+      } else if (m_phase == EPhase::Running) {
+        m_jstat &= ~0x08;
+        for (int i = 0; i < 4; ++i)
+          response[i] = jbus::u8(m_readCounter >> (i * 8));
+        response[4] = 0x28 | m_jstat;
+        ++m_readCounter;
+      }
+      return 5;
+    case CMD_WRITE:
+      if (m_phase == EPhase::Transmit) {
+        /* Alternate the transfer bit the host checks word to word */
+        response[0] = 0x20 | ((m_transmitWords ? (m_transmitWords - 1) & 1 : 0) << 4);
+        ++m_transmitWords;
+      } else if (m_phase == EPhase::Acknowledge) {
+        m_phase = EPhase::Running;
+        m_jstat = 0x08;
+        response[0] = 0x28;
+      } else if (m_phase == EPhase::Running) {
+        m_jstat |= 0x02;
+        response[0] = 0x28 | m_jstat;
+      }
+      return 1;
+    default:
+      return 1;
+    }
+  }
+
+  /** Check if the host completed a JoyBoot and the program is running. */
+  bool isBooted() const { return m_phase == EPhase::Running; }
+
+  /** Get number of program words received during the last JoyBoot. */
+  unsigned getTransmitWords() const { return m_transmitWords; }
+};
@@ -0,0 +1,143 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+#include "jbus/Common.hpp"
+#include "jbus/LinkConditioner.hpp"
+#include "jbus/Socket.hpp"
+#include "StandInGBA.hpp"
+
+/* Connects stand-in GBAs to a jbus host, one thread and one data/clock pair per peer */
+
+struct PeerConfig {
+  jbus::net::IPAddress address{"127.0.0.1"};
+  jbus::u16 dataPort = 0xd6ba;
+  jbus::u16 clockPort = 0xc10c;
+  std::optional<jbus::net::LinkConditionerOptions> conditioner;
+};
+
+/* Data and clock connections of one peer are paired by the listener in arrival order */
+static std::mutex ConnectLock;
+
+static std::atomic<unsigned> BootedPeers{0};
+
+static bool RecvAll(jbus::net::Socket& socket, jbus::u8* buf, size_t len) {
+  for (size_t received = 0; received < len;) {
+    size_t chunk = 0;
+    if (socket.recv(buf + received, len - received, chunk) != jbus::net::Socket::EResult::OK)
+      return false;
+    received += chunk;
+  }
+  return true;
+}
+
+static bool Connect(jbus::net::Socket& socket, const PeerConfig& config, jbus::u16 port) {
+  /* The host may not be listening yet */
+  for (int attempt = 0; attempt < 300; ++attempt) {
+    if (socket.openAndConnect(config.address, port))
+      return true;
+    jbus::WaitGCTicks(jbus::GetGCTicksPerSec() / 10);
+  }
+  return false;
+}
+
+static void RunPeer(unsigned index, const PeerConfig& config) {
+  jbus::net::Socket data(true);
+  jbus::net::Socket clock(false);
+  {
+    std::unique_lock lk(ConnectLock);
+    if (!Connect(data, config, config.dataPort) || !Connect(clock, config, config.clockPort)) {
+      fprintf(stderr, "peer %u: unable to connect\n", index);
+      return;
+    }
+  }
+  if (config.conditioner) {
+    jbus::net::LinkConditionerOptions options = *config.conditioner;
+    options.seed += index * 2;
+    data.setConditioner(options);
+    ++options.seed;
+    clock.setConditioner(options);
+  }
+
+  StandInGBA gba;
+  jbus::u64 commands = 0;
+  for (;;) {
+    /* Clock deltas only pace a real emulator; discard them */
+    jbus::u8 discard[64];
+    size_t discarded;
+    while (clock.recv(discard, sizeof(discard), discarded) == jbus::net::Socket::EResult::OK) {
+    }
+
+    jbus::u8 command[5];
+    if (!RecvAll(data, command, 1) || !RecvAll(data, command + 1, StandInGBA::CommandSize(command[0]) - 1))
+      break;
+    ++commands;
+
+    const bool wasBooted = gba.isBooted();
+    jbus::u8 response[5];
+    const size_t responseSize = gba.respond(command, response);
+    if (!wasBooted && gba.isBooted()) {
+      printf("peer %u: booted after %u program words\n", index, gba.getTransmitWords());
+      fflush(stdout);
+      ++BootedPeers;
+    }
+
+    if (data.send(response, responseSize) != jbus::net::Socket::EResult::OK)
+      break;
+  }
+
+  printf("peer %u: disconnected after %llu commands\n", index, static_cast<unsigned long long>(commands));
+}
+
+int main(int argc, char** argv) {
+  PeerConfig config;
+  unsigned peerCount = 1;
+  unsigned staggerMs = 0;
+  int argi = 1;
+  for (; argi < argc; ++argi) {
+    if (!strcmp(argv[argi], "-n") && argi + 1 < argc) {
+      peerCount = std::max(atoi(argv[++argi]), 1);
+    } else if (!strcmp(argv[argi], "-a") && argi + 1 < argc) {
+      config.address = jbus::net::IPAddress(argv[++argi]);
+    } else if (!strcmp(argv[argi], "-d") && argi + 1 < argc) {
+      staggerMs = std::max(atoi(argv[++argi]), 0);
+    } else if (!strcmp(argv[argi], "-l") && argi + 1 < argc) {
+      jbus::net::LinkConditionerOptions options;
+      if (!jbus::net::LinkConditionerOptions::Parse(argv[++argi], options)) {
+        fprintf(stderr, "Invalid link conditioner spec %s\n", argv[argi]);
+        return 1;
+      }
+      config.conditioner = options;
+    } else {
+      break;
+    }
+  }
+
+  if (argi < argc || !config.address) {
+    printf("Usage: gbapeer [-n <peers>] [-a <host address>] [-d <stagger ms>] [-l <conditioner>]\n"
+           "  -n  GBA stand-ins to connect (default 1)\n"
+           "  -a  address of the jbus host (default 127.0.0.1)\n"
+           "  -d  delay between connecting successive peers\n"
+           "  -l  condition inbound traffic, e.g. latency=8000,jitter=2000,rate=14400,chunk=2,seed=7\n"
+           "      (latency and jitter in microseconds, rate in bytes/s, chunk in bytes)\n");
+    return 1;
+  }
+
+  jbus::Initialize();
+  std::vector<std::thread> peers;
+  for (unsigned i = 0; i < peerCount; ++i) {
+    if (i && staggerMs)
+      jbus::WaitGCTicks(jbus::GetGCTicksPerSec() * staggerMs / 1000);
+    peers.emplace_back(RunPeer, i, std::cref(config));
+  }
+  for (std::thread& peer : peers)
+    peer.join();
+
+  printf("%u of %u peer(s) booted\n", BootedPeers.load(), peerCount);
+  return 0;
+}
@@ -0,0 +1,505 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <vector>
+#include "jbus/Endpoint.hpp"
+#include "jbus/LinkConditioner.hpp"
+#include "jbus/Listener.hpp"
+#include "jbus/RomImage.hpp"
+#include "jbus/Socket.hpp"
+#include "StandInGBA.hpp"
+
+#ifndef _WIN32
+#include <poll.h>
+#include <signal.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+/* Scalability harness: boots N stand-in GBAs through a Listener, then keeps every link busy with
+ * READ/WRITE round trips and reports what the host spent doing it. The peers run in a forked
+ * child process on a single event loop, so the reported CPU, memory, threads and context
+ * switches belong to the jbus host alone. */
+
+#ifndef _WIN32
+
+static double TicksToMs(jbus::u64 ticks) { return ticks * 1000.0 / jbus::GetGCTicksPerSec(); }
+
+/* Log-linear histogram of Dolphin ticks: 8 buckets per power of two, so reported percentiles
+ * are bucket upper bounds within 12.5% of the true value */
+class LatencyHistogram {
+  static constexpr unsigned SubBits = 3;
+  std::array<jbus::u64, 64 << SubBits> m_buckets{};
+  jbus::u64 m_count = 0;
+  jbus::u64 m_max = 0;
+
+  static size_t Index(jbus::u64 ticks) {
+    if (ticks < (1u << SubBits))
+      return size_t(ticks);
+    const unsigned shift = unsigned(std::bit_width(ticks)) - 1 - SubBits;
+    return ((shift + 1) << SubBits) + ((ticks >> shift) & ((1u << SubBits) - 1));
+  }
+
+  static jbus::u64 UpperBound(size_t index) {
+    if (index < (1u << SubBits))
+      return index;
+    const unsigned shift = unsigned(index >> SubBits) - 1;
+    const jbus::u64 mantissa = (1u << SubBits) + (index & ((1u << SubBits) - 1));
+    return ((mantissa + 1) << shift) - 1;
+  }
+
+public:
+  void add(jbus::u64 ticks) {
+    ++m_buckets[Index(ticks)];
+    ++m_count;
+    m_max = std::max(m_max, ticks);
+  }
+
+  void merge(const LatencyHistogram& other) {
+    for (size_t i = 0; i < m_buckets.size(); ++i)
+      m_buckets[i] += other.m_buckets[i];
+    m_count += other.m_count;
+    m_max = std::max(m_max, other.m_max);
+  }
+
+  jbus::u64 percentile(double fraction) const {
+    const jbus::u64 rank = std::max<jbus::u64>(1, jbus::u64(m_count * fraction + 0.5));
+    jbus::u64 seen = 0;
+    for (size_t i = 0; i < m_buckets.size(); ++i)
+      if ((seen += m_buckets[i]) >= rank)
+        return std::min(UpperBound(i), m_max);
+    return m_max;
+  }
+
+  jbus::u64 count() const { return m_count; }
+  jbus::u64 max() const { return m_max; }
+};
+
+/* Host side of one stand-in GBA. Callbacks touch it only from the endpoint's own transfer
+ * thread (or the polling thread), and the main thread reads it once the link goes quiet. */
+struct StressLink {
+  std::unique_ptr<jbus::Endpoint> endpoint;
+  jbus::u8 status = 0;
+  jbus::ReadWriteBuffer word{};
+  bool writing = true;
+  jbus::u64 acceptTicks = 0;
+  jbus::u64 bootTicks = 0;
+  bool bootFailed = false;
+  jbus::u64 issueTicks = 0;
+  jbus::u64 failures = 0;
+  LatencyHistogram latency;
+};
+
+static std::atomic<unsigned> PendingBoots{0};
+static std::atomic<unsigned> ActiveLinks{0};
+static std::atomic<bool> StopTraffic{false};
+
+/* Chain READ and WRITE commands from each completion until told to stop */
+template <class EP>
+static void IssueNext(StressLink& link, EP& endpoint) {
+  if (StopTraffic.load(std::memory_order_relaxed)) {
+    ActiveLinks.fetch_sub(1, std::memory_order_release);
+    return;
+  }
+
+  auto done = [&link](jbus::ThreadLocalEndpoint& ep, jbus::EJoyReturn status) {
+    link.latency.add(jbus::GetGCTicks() - link.issueTicks);
+    if (status != jbus::GBA_READY) {
+      ++link.failures;
+      ActiveLinks.fetch_sub(1, std::memory_order_release);
+      return;
+    }
+    IssueNext(link, ep);
+  };
+
+  link.issueTicks = jbus::GetGCTicks();
+  const jbus::EJoyReturn ret = link.writing ? endpoint.GBAWriteAsync(link.word, &link.status, std::move(done))
+                                            : endpoint.GBAReadAsync(link.word, &link.status, std::move(done));
+  link.writing = !link.writing;
+  if (ret != jbus::GBA_READY) {
+    ++link.failures;
+    ActiveLinks.fetch_sub(1, std::memory_order_release);
+  }
+}
+
+/* Polled mode: one host thread drives every endpoint, as an event-loop host would */
+static void PumpPolled(std::vector<StressLink>& links, jbus::u64 maxWaitTicks) {
+  std::vector<pollfd> fds;
+  fds.reserve(links.size());
+  jbus::u64 deadline = jbus::GetGCTicks() + maxWaitTicks;
+  for (StressLink& link : links) {
+    for (jbus::net::Socket::SocketTp fd : link.endpoint->pollFds())
+      fds.push_back({fd, POLLIN, 0});
+    deadline = std::min(deadline, link.endpoint->nextDeadline());
+  }
+
+  jbus::u64 now = jbus::GetGCTicks();
+  const int timeoutMs = deadline <= now ? 0 : int((deadline - now) * 1000 / jbus::GetGCTicksPerSec()) + 1;
+  poll(fds.data(), nfds_t(fds.size()), timeoutMs);
+
+  now = jbus::GetGCTicks();
+  for (StressLink& link : links)
+    link.endpoint->process(now);
+}
+
+template <class Pred>
+static void WaitFor(std::vector<StressLink>& links, bool polled, Pred&& done) {
+  while (!done()) {
+    if (polled)
+      PumpPolled(links, jbus::GetGCTicksPerSec() / 100);
+    else
+      jbus::WaitGCTicks(jbus::GetGCTicksPerSec() / 100);
+  }
+}
+
+struct ProcessSample {
+  double cpuSec = 0.0;
+  jbus::u64 voluntarySwitches = 0;
+  jbus::u64 involuntarySwitches = 0;
+  jbus::u64 rssKiB = 0;
+  unsigned threads = 0;
+};
+
+static ProcessSample SampleProcess() {
+  ProcessSample sample;
+  rusage usage = {};
+  getrusage(RUSAGE_SELF, &usage);
+  sample.cpuSec = usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+                  (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1000000.0;
+  sample.voluntarySwitches = usage.ru_nvcsw;
+  sample.involuntarySwitches = usage.ru_nivcsw;
+#ifdef __linux__
+  if (FILE* fp = fopen("/proc/self/status", "r")) {
+    char line[256];
+    while (fgets(line, sizeof(line), fp)) {
+      unsigned long long value;
+      if (sscanf(line, "VmRSS: %llu", &value) == 1)
+        sample.rssKiB = value;
+      else if (sscanf(line, "Threads: %llu", &value) == 1)
+        sample.threads = unsigned(value);
+    }
+    fclose(fp);
+  }
+#elif __APPLE__
+  sample.rssKiB = usage.ru_maxrss / 1024;
+#else
+  sample.rssKiB = usage.ru_maxrss;
+#endif
+  return sample;
+}
+
+/* Child process: connect every stand-in and serve them from a single poll loop until the host hangs up */
+struct StandInPeer {
+  jbus::net::Socket data{false};
+  jbus::net::Socket clock{false};
+  StandInGBA gba;
+  jbus::u8 command[5];
+  size_t received = 0;
+};
+
+static bool ConnectRetrying(jbus::net::Socket& socket, jbus::u16 port) {
+  const jbus::net::IPAddress address("127.0.0.1");
+  for (int attempt = 0; attempt < 300; ++attempt) {
+    if (socket.openAndConnect(address, port))
+      return true;
+    jbus::WaitGCTicks(jbus::GetGCTicksPerSec() / 10);
+  }
+  return false;
+}
+
+static void ServePeer(StandInPeer& peer) {
+  for (;;) {
+    const size_t needed = peer.received ? StandInGBA::CommandSize(peer.command[0]) : 1;
+    size_t chunk = 0;
+    const jbus::net::Socket::EResult result =
+        peer.data.recv(peer.command + peer.received, needed - peer.received, chunk);
+    if (result == jbus::net::Socket::EResult::Busy)
+      return;
+    if (result != jbus::net::Socket::EResult::OK) {
+      peer.data.close();
+      peer.clock.close();
+      return;
+    }
+
+    peer.received += chunk;
+    if (peer.received < StandInGBA::CommandSize(peer.command[0]))
+      continue;
+    peer.received = 0;
+
+    jbus::u8 response[5];
+    const size_t responseSize = peer.gba.respond(peer.command, response);
+    if (peer.data.send(response, responseSize) != jbus::net::Socket::EResult::OK) {
+      peer.data.close();
+      peer.clock.close();
+      return;
+    }
+  }
+}
+
+static int RunPeers(unsigned count) {
+  std::vector<StandInPeer> peers(count);
+  for (StandInPeer& peer : peers) {
+    /* Data then clock, one peer at a time, so the listener pairs them correctly */
+    if (!ConnectRetrying(peer.data, 0xd6ba) || !ConnectRetrying(peer.clock, 0xc10c)) {
+      fprintf(stderr, "stand-in peers: unable to connect\n");
+      return 1;
+    }
+  }
+
+  std::vector<pollfd> fds;
+  std::vector<StandInPeer*> owners;
+  for (;;) {
+    fds.clear();
+    owners.clear();
+    for (StandInPeer& peer : peers) {
+      if (peer.data) {
+        fds.push_back({peer.data.GetInternalSocket(), POLLIN, 0});
+        owners.push_back(&peer);
+      }
+      if (peer.clock) {
+        fds.push_back({peer.clock.GetInternalSocket(), POLLIN, 0});
+        owners.push_back(&peer);
+      }
+    }
+    if (fds.empty())
+      return 0;
+    if (poll(fds.data(), nfds_t(fds.size()), -1) <= 0)
+      continue;
+
+    for (size_t i = 0; i < fds.size(); ++i) {
+      if (!fds[i].revents)
+        continue;
+      StandInPeer& peer = *owners[i];
+      if (fds[i].fd == peer.data.GetInternalSocket()) {
+        ServePeer(peer);
+      } else if (fds[i].fd == peer.clock.GetInternalSocket()) {
+        /* Clock deltas only pace a real emulator; discard them */
+        jbus::u8 discard[256];
+        size_t discarded;
+        jbus::net::Socket::EResult result;
+        while ((result = peer.clock.recv(discard, sizeof(discard), discarded)) == jbus::net::Socket::EResult::OK) {
+        }
+        if (result == jbus::net::Socket::EResult::Error)
+          peer.clock.close();
+      }
+    }
+  }
+}
+
+int main(int argc, char** argv) {
+  unsigned linkCount = 100;
+  double trafficSec = 10.0;
+  bool polled = false;
+  size_t stackKiB = 0;
+  std::optional<jbus::net::LinkConditionerOptions> conditioner;
+  int argi = 1;
+  for (; argi < argc; ++argi) {
+    if (!strcmp(argv[argi], "-n") && argi + 1 < argc) {
+      linkCount = std::clamp(atoi(argv[++argi]), 1, 4096);
+    } else if (!strcmp(argv[argi], "-d") && argi + 1 < argc) {
+      trafficSec = std::max(atof(argv[++argi]), 0.1);
+    } else if (!strcmp(argv[argi], "-p")) {
+      polled = true;
+    } else if (!strcmp(argv[argi], "-k") && argi + 1 < argc) {
+      stackKiB = std::max(atoi(argv[++argi]), 0);
+    } else if (!strcmp(argv[argi], "-l") && argi + 1 < argc) {
+      jbus::net::LinkConditionerOptions options;
+      if (!jbus::net::LinkConditionerOptions::Parse(argv[++argi], options)) {
+        fprintf(stderr, "Invalid link conditioner spec %s\n", argv[argi]);
+        return 1;
+      }
+      conditioner = options;
+    } else {
+      break;
+    }
+  }
+
+  if (argc - argi != 1) {
+    printf("Usage: jbus_stress [-n <links>] [-d <traffic sec>] [-p] [-k <stack KiB>] [-l <conditioner>] "
+           "<client_pad.bin>\n"
+           "  -n  stand-in GBAs to connect and boot (default 100)\n"
+           "  -d  seconds of READ/WRITE traffic after every link booted (default 10)\n"
+           "  -p  drive all endpoints from one polling thread instead of a thread per endpoint\n"
+           "  -k  transfer thread stack size (default: platform default)\n"
+           "  -l  condition each host link, e.g. latency=8000,jitter=2000 (see joyboot)\n");
+    return 1;
+  }
+
+  jbus::RomImage::EResult loadResult;
+  std::shared_ptr<const jbus::RomImage> image = jbus::RomImage::Open(argv[argi], &loadResult);
+  if (!image) {
+    fprintf(stderr, "Unable to load %s: %s\n", argv[argi], jbus::RomImage::ResultString(loadResult));
+    return 1;
+  }
+
+  /* Two sockets per link on each side */
+  rlimit files = {};
+  if (getrlimit(RLIMIT_NOFILE, &files) == 0 && files.rlim_cur < files.rlim_max) {
+    files.rlim_cur = files.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &files);
+  }
+  if (files.rlim_cur < rlim_t(linkCount) * 2 + 64) {
+    fprintf(stderr, "Open file limit %llu is too low for %u links\n", (unsigned long long)files.rlim_cur, linkCount);
+    return 1;
+  }
+
+  jbus::Initialize();
+
+  /* Fork while still single-threaded; the peers retry until the listener is up */
+  const pid_t peerPid = fork();
+  if (peerPid < 0) {
+    perror("fork");
+    return 1;
+  }
+  if (peerPid == 0)
+    _exit(RunPeers(linkCount));
+
+  const ProcessSample baseline = SampleProcess();
+
+  jbus::ListenerOptions listenerOptions;
+  listenerOptions.backlog = std::max<int>(jbus::net::Socket::DefaultBacklog, int(linkCount));
+  listenerOptions.queueCapacity = linkCount;
+  listenerOptions.endpointOptions.polled = polled;
+  listenerOptions.endpointOptions.transferThread.stackSize = stackKiB * 1024;
+  listenerOptions.endpointOptions.linkConditioner = conditioner;
+  jbus::Listener listener(listenerOptions);
+  if (!listener.start()) {
+    fprintf(stderr, "Unable to start listener\n");
+    kill(peerPid, SIGTERM);
+    waitpid(peerPid, nullptr, 0);
+    return 1;
+  }
+
+  printf("Connecting %u stand-in GBA(s), %s\n", linkCount,
+         polled ? "polled from one thread" : "one transfer thread per endpoint");
+  fflush(stdout);
+  std::vector<StressLink> links(linkCount);
+  const jbus::u64 connectStart = jbus::GetGCTicks();
+  const jbus::u64 connectDeadline = connectStart + jbus::GetGCTicksPerSec() * (30 + linkCount / 50);
+  unsigned connected = 0;
+  for (; connected < linkCount; ++connected) {
+    links[connected].endpoint = listener.acceptWait(connectDeadline);
+    if (!links[connected].endpoint)
+      break;
+    links[connected].endpoint->setChan(connected % 4);
+    links[connected].acceptTicks = jbus::GetGCTicks();
+  }
+  const jbus::u64 connectTicks = jbus::GetGCTicks() - connectStart;
+  if (connected < linkCount) {
+    fprintf(stderr, "Only %u of %u links connected\n", connected, linkCount);
+    links.resize(connected);
+    kill(peerPid, SIGTERM);
+  }
+  listener.stop();
+  const ProcessSample connectedSample = SampleProcess();
+
+  /* Boot every link at once */
+  const jbus::u64 bootStart = jbus::GetGCTicks();
+  PendingBoots = unsigned(links.size());
+  for (StressLink& link : links) {
+    const jbus::EJoyReturn ret = link.endpoint->GBAJoyBootAsync(
+        2, 2, image->data(), image->size(), &link.status,
+        [&link](jbus::ThreadLocalEndpoint&, const jbus::JoyBootResult& result) {
+          link.bootTicks = result.endTicks - result.startTicks;
+          link.bootFailed = result.status != jbus::GBA_READY;
+          PendingBoots.fetch_sub(1, std::memory_order_release);
+        });
+    if (ret != jbus::GBA_READY) {
+      link.bootFailed = true;
+      PendingBoots.fetch_sub(1, std::memory_order_release);
+    }
+  }
+  WaitFor(links, polled, []() { return PendingBoots.load(std::memory_order_acquire) == 0; });
+  const jbus::u64 bootTotalTicks = jbus::GetGCTicks() - bootStart;
+
+  LatencyHistogram bootLatency;
+  unsigned bootFailures = 0;
+  for (const StressLink& link : links) {
+    if (link.bootFailed)
+      ++bootFailures;
+    else
+      bootLatency.add(link.bootTicks);
+  }
+
+  /* Sustained traffic on every booted link */
+  const ProcessSample trafficStart = SampleProcess();
+  const jbus::u64 trafficStartTicks = jbus::GetGCTicks();
+  const jbus::u64 trafficEndTicks = trafficStartTicks + jbus::u64(trafficSec * jbus::GetGCTicksPerSec());
+  for (StressLink& link : links) {
+    if (link.bootFailed)
+      continue;
+    ActiveLinks.fetch_add(1, std::memory_order_relaxed);
+    IssueNext(link, *link.endpoint);
+  }
+  ProcessSample trafficMid;
+  bool sampled = false;
+  WaitFor(links, polled, [&]() {
+    const jbus::u64 now = jbus::GetGCTicks();
+    if (!sampled && now >= trafficStartTicks + (trafficEndTicks - trafficStartTicks) / 2) {
+      trafficMid = SampleProcess();
+      sampled = true;
+    }
+    return now >= trafficEndTicks;
+  });
+  const ProcessSample trafficEnd = SampleProcess();
+  const jbus::u64 trafficTicks = jbus::GetGCTicks() - trafficStartTicks;
+  StopTraffic = true;
+  WaitFor(links, polled, []() { return ActiveLinks.load(std::memory_order_acquire) == 0; });
+
+  LatencyHistogram latency;
+  jbus::u64 failures = 0;
+  for (const StressLink& link : links) {
+    latency.merge(link.latency);
+    failures += link.failures;
+  }
+
+  const double n = double(std::max<size_t>(links.size(), 1));
+  const double trafficWallSec = trafficTicks / double(jbus::GetGCTicksPerSec());
+  const double cpuSec = trafficEnd.cpuSec - trafficStart.cpuSec;
+  const jbus::u64 voluntary = trafficEnd.voluntarySwitches - trafficStart.voluntarySwitches;
+  const jbus::u64 involuntary = trafficEnd.involuntarySwitches - trafficStart.involuntarySwitches;
+  const jbus::u64 commands = latency.count();
+
+  printf("\nLinks             %zu of %u connected in %.2f s\n", links.size(), linkCount, TicksToMs(connectTicks) / 1000);
+  printf("Boot              %zu booted, %u failed, all done in %.2f s; per link p50 %.1f ms, p99 %.1f ms\n",
+         size_t(bootLatency.count()), bootFailures, TicksToMs(bootTotalTicks) / 1000,
+         TicksToMs(bootLatency.percentile(0.5)), TicksToMs(bootLatency.percentile(0.99)));
+  printf("Traffic           %llu commands in %.2f s (%.0f/s, %.0f/s per link), %llu failed\n",
+         (unsigned long long)commands, trafficWallSec, commands / trafficWallSec, commands / trafficWallSec / n,
+         (unsigned long long)failures);
+  printf("Latency           p50 %.3f ms, p90 %.3f ms, p99 %.3f ms, p99.9 %.3f ms, max %.3f ms\n",
+         TicksToMs(latency.percentile(0.5)), TicksToMs(latency.percentile(0.9)),
+         TicksToMs(latency.percentile(0.99)), TicksToMs(latency.percentile(0.999)), TicksToMs(latency.max()));
+  printf("CPU               %.1f%% of one core; %.3f ms per link-second; %.2f us per command\n",
+         cpuSec * 100.0 / trafficWallSec, cpuSec * 1000.0 / trafficWallSec / n,
+         commands ? cpuSec * 1000000.0 / commands : 0.0);
+  printf("Memory            RSS %.1f MiB, %.1f KiB per link over the %.1f MiB baseline\n",
+         trafficMid.rssKiB / 1024.0, (double(trafficMid.rssKiB) - double(baseline.rssKiB)) / n,
+         baseline.rssKiB / 1024.0);
+  printf("Threads           %u with links connected, %u at baseline\n", connectedSample.threads, baseline.threads);
+  printf("Context switches  %llu voluntary, %llu involuntary (%.0f/s, %.2f per command)\n",
+         (unsigned long long)voluntary, (unsigned long long)involuntary, (voluntary + involuntary) / trafficWallSec,
+         commands ? double(voluntary + involuntary) / commands : 0.0);
+
+  /* Closing the host sockets lets the stand-ins exit */
+  links.clear();
+  int peerStatus = 0;
+  waitpid(peerPid, &peerStatus, 0);
+  return bootFailures || failures || connected < linkCount ? 2 : 0;
+}
+
+#else
+
+int main(int, char**) {
+  fprintf(stderr, "jbus_stress requires a POSIX host\n");
+  return 1;
+}
+
+#endif
@@ -1,67 +1,394 @@
+#include <algorithm>
+#include <array>
+#include <csignal>
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <list>
+#include <vector>
+#include "jbus/BootOrchestrator.hpp"
+#include "jbus/ChromeTrace.hpp"
 #include "jbus/Listener.hpp"
 #include "jbus/Endpoint.hpp"
+#include "jbus/PollGroup.hpp"
+#include "jbus/RomImage.hpp"
+#include "jbus/Tracer.hpp"
 #include <functional>
 
-static void clientPadComplimentCheck(jbus::u8* buffer) {
-  jbus::u8 check = 0x19;
-  for (int i = 0xa0; i < 0xbd; ++i)
-    check += buffer[i];
-  buffer[0xbd] = -check;
+static volatile std::sig_atomic_t ServeStop = 0;
+
+static void ServeSignal(int) { ServeStop = 1; }
+
+static double TicksToMs(jbus::u64 ticks) { return ticks * 1000.0 / jbus::GetGCTicksPerSec(); }
+
+/* One client tracked from accept until the GBA reports the program running */
+struct ServeClient {
+  unsigned id = 0;
+  jbus::net::IPAddress address;
+  jbus::u64 acceptTicks = 0;
+  jbus::u64 startTicks = 0;
+  jbus::u64 endTicks = 0;
+  jbus::JoyBootResult joyBoot;
+  std::unique_ptr<jbus::Endpoint> endpoint;
+};
+
+/* Where the JoyBoot itself spent its time: GBA round trips, the GBA's own boot, or our cipher */
+static void PrintJoyBootPhases(const jbus::JoyBootResult& result) {
+  if (!result.transmitStartTicks || !result.transmitEndTicks)
+    return;
+  printf("    challenge %.1f ms, transmit %.1f ms, boot poll %.1f ms (%u polls), host %.2f ms, %u round trips\n",
+         TicksToMs(result.transmitStartTicks - result.startTicks),
+         TicksToMs(result.transmitEndTicks - result.transmitStartTicks),
+         result.bootPollEndTicks ? TicksToMs(result.bootPollEndTicks - result.bootPollStartTicks) : 0.0,
+         result.bootPolls, TicksToMs(result.hostTicks), result.commands);
 }
 
-static jbus::EJoyReturn BootStatus = jbus::GBA_JOYBOOT_ERR_INVALID;
-static void JoyBootDone(jbus::ThreadLocalEndpoint& endpoint, jbus::EJoyReturn status) { BootStatus = status; }
+/* A booted program is running once the STATUS that follows a RESET reads exactly PSF1 | SEND */
+static constexpr jbus::u8 ProgramRunningJStat = jbus::GBA_JSTAT_PSF1 | jbus::GBA_JSTAT_SEND;
 
-static bool DonePoll(jbus::Endpoint& endpoint) {
-  jbus::u8 status;
-  if (endpoint.GBAReset(&status) == jbus::GBA_NOT_READY)
-    if (endpoint.GBAReset(&status) == jbus::GBA_NOT_READY)
-      return false;
+/* Runs the running-program check for every client in a PollGroup without blocking:
+ * once per frame, a RESET round and then a STATUS round */
+struct ServeDonePoll {
+  jbus::PollGroup group;
+  jbus::PollGroup::ECommand command = jbus::PollGroup::ECommand::Status;
+  bool roundIssued = false;
+  jbus::u64 lastRoundTicks = 0;
 
-  if (endpoint.GBAGetStatus(&status) == jbus::GBA_NOT_READY)
+  /* Returns true once a STATUS round is published; until the next call, members may be added and removed */
+  bool pump(jbus::u64 now) {
+    if (roundIssued) {
+      if (!group.collect())
+        return false;
+      roundIssued = false;
+      if (command == jbus::PollGroup::ECommand::Status)
+        return true;
+      start(jbus::PollGroup::ECommand::Status);
+      return false;
+    }
+    if (group.size() && now - lastRoundTicks >= jbus::GetGCTicksPerSec() / 60) {
+      lastRoundTicks = now;
+      start(jbus::PollGroup::ECommand::Reset);
+    }
     return false;
-  if (status != (jbus::GBA_JSTAT_PSF1 | jbus::GBA_JSTAT_SEND))
+  }
+
+  void start(jbus::PollGroup::ECommand next) {
+    command = next;
+    group.setCommand(command);
+    roundIssued = group.pollAsync() == jbus::GBA_READY;
+  }
+
+  bool running(const jbus::Endpoint& endpoint) const {
+    for (size_t i = 0; i < group.size(); ++i)
+      if (group.getEndpoint(i) == &endpoint)
+        return group.status()[i] == jbus::GBA_READY && group.jstat()[i] == ProgramRunningJStat;
     return false;
+  }
+};
+
+struct ServeStats {
+  /* Percentiles cover the most recent boots so a server left running keeps a fixed footprint */
+  static constexpr size_t LatencyWindow = 1024;
+
+  jbus::u64 startTicks = jbus::GetGCTicks();
+  jbus::u64 booted = 0;
+  jbus::u64 failed = 0;
+  std::array<double, LatencyWindow> latencyMs{};
+
+  void addBooted(double ms) { latencyMs[booted++ % LatencyWindow] = ms; }
+
+  void print() {
+    double elapsed = TicksToMs(jbus::GetGCTicks() - startTicks) / 1000.0;
+    printf("== %llu booted, %llu failed, %.2f boots/s", (unsigned long long)booted, (unsigned long long)failed,
+           elapsed > 0.0 ? booted / elapsed : 0.0);
+    if (booted) {
+      const size_t count = std::min<size_t>(booted, LatencyWindow);
+      std::array<double, LatencyWindow> sorted = latencyMs;
+      std::sort(sorted.begin(), sorted.begin() + count);
+      auto percentile = [&sorted, count](double p) { return sorted[std::min(count - 1, size_t(count * p))]; };
+      printf(", latency p50 %.1f ms p99 %.1f ms over the last %zu", percentile(0.5), percentile(0.99), count);
+    }
+    printf("\n");
+    fflush(stdout);
+  }
+};
+
+/* Boot clients indefinitely, up to `concurrency` at once, until interrupted */
+static int Serve(const char* path, unsigned concurrency, jbus::u64 settleTicks, const char* tracePath,
+                 const jbus::ListenerOptions& listenerOptions) {
+  jbus::RomImageCache romCache;
+  jbus::RomImage::EResult loadResult;
+  std::shared_ptr<const jbus::RomImage> image = romCache.get(path, &loadResult);
+  if (!image) {
+    fprintf(stderr, "Unable to load %s: %s\n", path, jbus::RomImage::ResultString(loadResult));
+    return 1;
+  }
+
+  std::signal(SIGINT, ServeSignal);
+  std::signal(SIGTERM, ServeSignal);
+
+  jbus::Initialize();
+  jbus::Listener listener(listenerOptions);
+  if (!listener.start()) {
+    fprintf(stderr, "Unable to start listener\n");
+    return 1;
+  }
+  printf("Serving %s to up to %u concurrent client(s); Ctrl-C to stop\n", path, concurrency);
+
+  /* An orchestrator drives four SI channels; run as many as the concurrency needs.
+   * Each keeps the image its in-flight uploads read from alive until it switches over. */
+  struct Farm {
+    std::unique_ptr<jbus::BootOrchestrator> orchestrator;
+    std::shared_ptr<const jbus::RomImage> image;
+    std::array<std::unique_ptr<ServeClient>, 4> clients;
+  };
+  std::vector<Farm> farms((concurrency + 3) / 4);
+  for (Farm& farm : farms) {
+    farm.orchestrator = std::make_unique<jbus::BootOrchestrator>(image->data(), image->size());
+    farm.orchestrator->setSettleTicks(settleTicks);
+    farm.image = image;
+  }
+
+  std::list<std::unique_ptr<ServeClient>> finishing;
+  ServeDonePoll donePoll;
+  ServeStats stats;
+  jbus::ChromeTraceWriter trace;
+  unsigned active = 0;
+  unsigned nextId = 0;
+  const jbus::u64 pollInterval = jbus::GetGCTicksPerSec() / 500;
+  jbus::u64 lastReload = jbus::GetGCTicks();
+  jbus::u64 lastReport = lastReload;
+
+  while (!ServeStop) {
+    jbus::u64 now = jbus::GetGCTicks();
+
+    /* Pick up a rebuilt image; farms switch over once nothing on them is mid-upload */
+    if (now - lastReload >= jbus::GetGCTicksPerSec()) {
+      lastReload = now;
+      if (std::shared_ptr<const jbus::RomImage> latest = romCache.get(path, &loadResult))
+        image = latest;
+      else
+        fprintf(stderr, "Keeping previous image; unable to reload %s: %s\n", path,
+                jbus::RomImage::ResultString(loadResult));
+    }
+
+    for (Farm& farm : farms) {
+      if (farm.image != image) {
+        bool booting = false;
+        for (unsigned i = 0; i < 4; ++i)
+          booting |= farm.orchestrator->getProgress(i).state == jbus::BootOrchestrator::EChannelState::Booting;
+        if (!booting) {
+          farm.orchestrator->setProgram(image->data(), image->size());
+          farm.image = image;
+        }
+      }
+
+      farm.orchestrator->pump();
+      for (unsigned i = 0; i < 4; ++i) {
+        jbus::BootOrchestrator::ChannelProgress progress = farm.orchestrator->getProgress(i);
+        if (progress.state != jbus::BootOrchestrator::EChannelState::Done &&
+            progress.state != jbus::BootOrchestrator::EChannelState::Failed)
+          continue;
+
+        std::unique_ptr<ServeClient> client = std::move(farm.clients[i]);
+        client->startTicks = progress.startTicks;
+        client->endTicks = progress.endTicks;
+        client->joyBoot = progress.joyBoot;
+        client->endpoint = farm.orchestrator->releaseEndpoint(i);
+        --active;
+        if (progress.state == jbus::BootOrchestrator::EChannelState::Failed) {
+          ++stats.failed;
+          printf("boot #%u from %s failed with %d status\n", client->id, client->address.toString().c_str(),
+                 progress.status);
+          PrintJoyBootPhases(client->joyBoot);
+          if (tracePath)
+            trace.joyBoot(client->joyBoot, 1, client->id);
+          continue;
+        }
+        finishing.push_back(std::move(client));
+      }
+    }
 
-  return true;
+    /* Wait for the booted program to come up before counting the boot; the group only changes between rounds */
+    const bool polled = donePoll.pump(now);
+    for (auto it = finishing.begin(); it != finishing.end();) {
+      ServeClient& client = **it;
+      if (polled && donePoll.running(*client.endpoint)) {
+        donePoll.group.removeEndpoint(*client.endpoint);
+        jbus::u64 readyTicks = jbus::GetGCTicks();
+        double totalMs = TicksToMs(readyTicks - client.acceptTicks);
+        stats.addBooted(totalMs);
+        printf("boot #%u from %s: settle %.1f ms, upload %.1f ms, ready %.1f ms, total %.1f ms\n", client.id,
+               client.address.toString().c_str(), TicksToMs(client.startTicks - client.acceptTicks),
+               TicksToMs(client.endTicks - client.startTicks), TicksToMs(readyTicks - client.endTicks), totalMs);
+        PrintJoyBootPhases(client.joyBoot);
+        if (tracePath) {
+          trace.complete("settle", "serve", client.acceptTicks, client.startTicks, 1, client.id);
+          trace.joyBoot(client.joyBoot, 1, client.id);
+          trace.complete("ready", "serve", client.endTicks, readyTicks, 1, client.id);
+        }
+        it = finishing.erase(it);
+      } else if (!donePoll.roundIssued &&
+                 jbus::s64(now - client.endTicks) > jbus::s64(jbus::GetGCTicksPerSec()) * 15) {
+        donePoll.group.removeEndpoint(*client.endpoint);
+        ++stats.failed;
+        printf("boot #%u from %s: program did not start\n", client.id, client.address.toString().c_str());
+        it = finishing.erase(it);
+      } else {
+        if (!donePoll.roundIssued)
+          donePoll.group.addEndpoint(*client.endpoint);
+        ++it;
+      }
+    }
+
+    if (now - lastReport >= jbus::GetGCTicksPerSec() * 10) {
+      lastReport = now;
+      stats.print();
+    }
+
+    /* Sleep until the next poll, waking early for a new client while there is room for one */
+    jbus::u64 deadline = jbus::GetGCTicks() + pollInterval;
+    if (active < concurrency) {
+      if (std::unique_ptr<jbus::Endpoint> endpoint = listener.acceptWait(deadline)) {
+        auto client = std::make_unique<ServeClient>();
+        client->id = nextId++;
+        client->address = endpoint->getPeerAddress();
+        client->acceptTicks = jbus::GetGCTicks();
+        for (Farm& farm : farms) {
+          int chan = farm.orchestrator->addEndpoint(std::move(endpoint));
+          if (chan >= 0) {
+            farm.clients[chan] = std::move(client);
+            break;
+          }
+        }
+        ++active;
+      }
+    } else {
+      jbus::WaitGCTicks(pollInterval);
+    }
+  }
+
+  printf("\n");
+  stats.print();
+  listener.stop();
+  if (tracePath && !trace.write(tracePath)) {
+    fprintf(stderr, "Unable to write trace to %s\n", tracePath);
+    return 1;
+  }
+  return 0;
 }
 
 int main(int argc, char** argv) {
-  if (argc < 2) {
-    printf("Usage: joyboot <client_pad.bin>\n");
-    return 1;
+  /* 0 until -n is given; the default depends on the mode */
+  unsigned clientCount = 0;
+  bool serve = false;
+  const char* tracePath = nullptr;
+  const char* endpointTracePath = nullptr;
+  jbus::ListenerOptions listenerOptions;
+  jbus::u64 settleTicks = jbus::GetGCTicksPerSec() * 4;
+  int argi = 1;
+  for (; argi < argc; ++argi) {
+    if (!strcmp(argv[argi], "-n") && argi + 1 < argc)
+      clientCount = std::max(atoi(argv[++argi]), 1);
+    else if (!strcmp(argv[argi], "-s") && argi + 1 < argc)
+      settleTicks = jbus::GetGCTicksPerSec() * std::max(atoi(argv[++argi]), 0) / 1000;
+    else if (!strcmp(argv[argi], "-t") && argi + 1 < argc)
+      tracePath = argv[++argi];
+    else if (!strcmp(argv[argi], "-T") && argi + 1 < argc)
+      endpointTracePath = argv[++argi];
+    else if (!strcmp(argv[argi], "-l") && argi + 1 < argc) {
+      jbus::net::LinkConditionerOptions conditioner;
+      if (!jbus::net::LinkConditionerOptions::Parse(argv[++argi], conditioner)) {
+        fprintf(stderr, "Invalid link conditioner spec %s\n", argv[argi]);
+        return 1;
+      }
+      listenerOptions.endpointOptions.linkConditioner = conditioner;
+    } else if (!strcmp(argv[argi], "--serve"))
+      serve = true;
+    else
+      break;
   }
 
-  FILE* fp = fopen(argv[1], "rb");
-  if (!fp) {
-    fprintf(stderr, "Unable to open %s\n", argv[1]);
+  if (argc <= argi) {
+    printf("Usage: joyboot [-n <clients>] [-s <settle ms>] [-t <trace.json>] [-T <trace.json>] [-l <conditioner>] "
+           "[--serve] <client_pad.bin>\n"
+           "  -n       clients to boot (1-4, default 1), or concurrent boots with --serve (default 4)\n"
+           "  -s       delay between accepting a client and booting it (default 4000)\n"
+           "  -t       write JoyBoot phase timings as Chrome trace-event JSON on exit\n"
+           "  -T       stream every command's lock wait, send and receive spans as Chrome trace-event JSON\n"
+           "  -l       condition each client's link for testing, e.g. latency=8000,jitter=2000,rate=14400,chunk=2\n"
+           "           (latency and jitter in microseconds, rate in bytes/s, chunk in bytes, optional seed)\n"
+           "  --serve  boot clients until interrupted, reporting boot latency and throughput\n");
     return 1;
   }
 
-  fseek(fp, 0, SEEK_END);
-  int fsize = ftell(fp);
-  fseek(fp, 0, SEEK_SET);
-  std::unique_ptr<jbus::u8[]> data(new jbus::u8[fsize]);
-  fread(data.get(), 1, fsize, fp);
-  fclose(fp);
-  if (fsize < 512) {
-    fprintf(stderr, "%s must be at least 512 bytes\n", argv[1]);
+  /* Stopped on every return path so the trace is always closed */
+  struct EndpointTrace {
+    ~EndpointTrace() { jbus::Tracer::Stop(); }
+  } endpointTrace;
+  if (endpointTracePath && !jbus::Tracer::Start(endpointTracePath)) {
+    fprintf(stderr, "Unable to write trace to %s\n", endpointTracePath);
     return 1;
   }
 
-  clientPadComplimentCheck(data.get());
+  /* One orchestrator's worth of channels keeps a server busy without any tuning */
+  if (serve)
+    return Serve(argv[argi], clientCount ? clientCount : 4, settleTicks, tracePath, listenerOptions);
+  clientCount = std::clamp(clientCount, 1u, 4u);
+
+  const char* path = argv[argi];
+  jbus::RomImageCache romCache;
+  jbus::RomImage::EResult loadResult;
+  std::shared_ptr<const jbus::RomImage> image = romCache.get(path, &loadResult);
+  if (!image) {
+    fprintf(stderr, "Unable to load %s: %s\n", path, jbus::RomImage::ResultString(loadResult));
+    return 1;
+  }
 
   jbus::Initialize();
-  printf("Listening for client\n");
-  jbus::Listener listener;
-  listener.start();
-  std::unique_ptr<jbus::Endpoint> endpoint;
-  while (true) {
+  printf("Listening for %u client(s)\n", clientCount);
+  jbus::Listener listener(listenerOptions);
+  if (!listener.start()) {
+    fprintf(stderr, "Unable to start listener\n");
+    return 1;
+  }
+
+  /* Each client is booted on its own SI channel as soon as it connects */
+  jbus::BootOrchestrator orchestrator(image->data(), image->size());
+  orchestrator.setSettleTicks(settleTicks);
+  unsigned accepted = 0;
+  std::array<jbus::u8, 4> lastpercent{};
+  while (accepted < clientCount || !orchestrator.allDone()) {
     jbus::s64 frameStart = jbus::GetGCTicks();
-    endpoint = listener.accept();
-    if (endpoint)
-      break;
+    if (accepted < clientCount) {
+      unsigned newClients = orchestrator.acceptFrom(listener);
+      if (newClients)
+        printf("\nAccepted client; waiting %.1f sec\n", settleTicks / double(jbus::GetGCTicksPerSec()));
+      accepted += newClients;
+    }
+
+    orchestrator.pump();
+
+    bool changed = false;
+    for (unsigned i = 0; i < accepted; ++i) {
+      jbus::BootOrchestrator::ChannelProgress progress = orchestrator.getProgress(i);
+      if (progress.state == jbus::BootOrchestrator::EChannelState::Booting &&
+          jbus::s64(frameStart - progress.startTicks) > jbus::s64(jbus::GetGCTicksPerSec()) * 10) {
+        fprintf(stderr, "\nJoyBoot timeout on channel %u\n", i);
+        return 1;
+      }
+      if (progress.percent != lastpercent[i]) {
+        lastpercent[i] = progress.percent;
+        changed = true;
+      }
+    }
+    if (changed) {
+      printf("\rUpload");
+      for (unsigned i = 0; i < accepted; ++i)
+        printf(" [%u] %d%%", i, lastpercent[i]);
+      fflush(stdout);
+    }
+
     jbus::s64 frameEnd = jbus::GetGCTicks();
     jbus::s64 passedTicks = frameEnd - frameStart;
     jbus::s64 waitTicks = jbus::GetGCTicksPerSec() / 60 - passedTicks;
@@ -69,44 +396,40 @@ int main(int argc, char** argv) {
       jbus::WaitGCTicks(waitTicks);
   }
 
-  printf("Waiting 4 sec\n");
-  jbus::WaitGCTicks(jbus::GetGCTicksPerSec() * 4);
-
-  jbus::u8 status;
-  if (endpoint->GBAJoyBootAsync(2, 2, data.get(), fsize, &status,
-                                std::bind(JoyBootDone, std::placeholders::_1, std::placeholders::_2)) !=
-      jbus::GBA_READY) {
-    fprintf(stderr, "Unable to start JoyBoot\n");
-    return 1;
-  }
-
-  jbus::s64 start = jbus::GetGCTicks();
-  jbus::u8 percent = 0;
-  jbus::u8 lastpercent = 0;
-  while (endpoint->GBAGetProcessStatus(percent) == jbus::GBA_BUSY) {
-    if (percent != lastpercent) {
-      lastpercent = percent;
-      printf("\rUpload %d%%", percent);
-      fflush(stdout);
-    }
-    jbus::s64 curTime = jbus::GetGCTicks();
-    jbus::s64 passedTicks = curTime - start;
-    if (passedTicks > jbus::s64(jbus::GetGCTicksPerSec()) * 10) {
-      fprintf(stderr, "JoyBoot timeout\n");
-      return 1;
-    }
-    jbus::WaitGCTicks(jbus::GetGCTicksPerSec() / 60);
+  printf("\n");
+  bool failed = false;
+  jbus::ChromeTraceWriter trace;
+  for (unsigned i = 0; i < accepted; ++i) {
+    jbus::BootOrchestrator::ChannelProgress progress = orchestrator.getProgress(i);
+    printf("Joy Boot [%u] finished with %d status\n", i, progress.status);
+    PrintJoyBootPhases(progress.joyBoot);
+    trace.joyBoot(progress.joyBoot, 1, i);
+    if (progress.state != jbus::BootOrchestrator::EChannelState::Done)
+      failed = true;
   }
-  printf("\nJoy Boot finished with %d status\n", status);
+  if (tracePath && !trace.write(tracePath))
+    fprintf(stderr, "Unable to write trace to %s\n", tracePath);
+  printf("Aggregate upload throughput %.1f KiB/s\n", orchestrator.getThroughput() / 1024.0);
+  if (failed)
+    return 1;
 
-  while (!DonePoll(*endpoint)) {
-    jbus::s64 curTime = jbus::GetGCTicks();
-    jbus::s64 passedTicks = curTime - start;
-    if (passedTicks > jbus::s64(jbus::GetGCTicksPerSec()) * 15) {
+  /* Each frame, reset every client in one round and read JOYSTAT in the next until each program reports PSF1 */
+  jbus::PollGroup donePoll;
+  for (unsigned i = 0; i < accepted; ++i)
+    donePoll.addEndpoint(*orchestrator.getEndpoint(i));
+  const jbus::u64 frameTicks = jbus::GetGCTicksPerSec() / 60;
+  const jbus::u64 deadline = jbus::GetGCTicks() + jbus::GetGCTicksPerSec() * 15;
+  while (donePoll.size()) {
+    jbus::u64 now = jbus::GetGCTicks();
+    donePoll.setCommand(jbus::PollGroup::ECommand::Reset);
+    if (now >= deadline || donePoll.poll(deadline - now) != jbus::GBA_READY) {
       fprintf(stderr, "JoyBoot timeout\n");
       return 1;
     }
-    jbus::WaitGCTicks(jbus::GetGCTicksPerSec() / 60);
+    donePoll.setCommand(jbus::PollGroup::ECommand::Status);
+    int done = donePoll.waitAny(0xff, ProgramRunningJStat, frameTicks, frameTicks);
+    if (done >= 0)
+      donePoll.removeEndpoint(*donePoll.getEndpoint(done));
   }
 
   return 0;